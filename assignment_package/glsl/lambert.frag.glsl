@@ -23,6 +23,7 @@ in vec4 fs_Nor;
 in vec4 fs_LightVec;
 in vec4 fs_UV;
 in vec4 fs_lsPos;
+flat in vec2 fs_Tile;
 
 out vec4 out_Col; // This is the final output color that you will see on your
                   // screen for the pixel that is currently being processed.
@@ -63,6 +64,9 @@ void main()
 
 
         vec2 UV = vec2(fs_UV);
+        // Greedy-meshed quads span several blocks and their UVs run past
+        // the edge of the tile, so wrap them back to repeat it once per block
+        UV = fs_Tile + mod(UV - fs_Tile, 0.0625);
 
         if (fs_UV.z == 1) { //animated flag
             UV += timeOffsetUV();
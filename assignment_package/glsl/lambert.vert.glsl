@@ -24,30 +24,43 @@ uniform mat4 u_DepthVP;
                             // We've written a static matrix for you to use for HW2,
                             // but in HW3 you'll have to generate one yourself
 
-in vec4 vs_Pos;             // The array of vertex positions passed to the shader
-
-in vec4 vs_Nor;             // The array of vertex normals passed to the shader
-
-in vec4 vs_UV;
+in uvec2 vs_Packed;         // A packed chunk vertex, laid out as described in chunkvertex.h
 
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
 out vec4 fs_UV;
 out vec4 fs_lsPos;
+flat out vec2 fs_Tile;
+
+// Indexed by the Direction enum in chunk.h
+const vec3 normals[6] = vec3[6](vec3(1, 0, 0), vec3(-1, 0, 0),
+                                vec3(0, 1, 0), vec3(0, -1, 0),
+                                vec3(0, 0, 1), vec3(0, 0, -1));
 
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
 void main()
 {
-    fs_UV = vs_UV;                         // Pass the vertex uvs to the fragment shader for interpolation
+    uint posNor = vs_Packed.x;
+    uint uv = vs_Packed.y;
+    vec3 nor = normals[(posNor >> 19u) & 7u];
+    vec3 pos = vec3(posNor & 31u, (posNor >> 5u) & 511u, (posNor >> 14u) & 31u);
+    // Inset faces (cactus sides) are pulled one texel into their block
+    pos -= nor * float((posNor >> 22u) & 1u) / 16.0;
+    vec4 vs_Pos = vec4(pos, 1);
+
+    vec2 tile = vec2(uv & 15u, (uv >> 4u) & 15u);
+    vec2 faceUV = vec2((uv >> 8u) & 511u, (uv >> 17u) & 511u);
+    fs_UV = vec4((tile + faceUV) / 16.0, (uv >> 26u) & 1u, (uv >> 27u) & 1u);
+    fs_Tile = tile / 16.0;
 
     vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
     fs_Pos = u_ViewProj * modelposition;
     fs_lsPos = u_DepthVP * modelposition;
 
     mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
+    fs_Nor = vec4(invTranspose * nor, 0);                // Pass the vertex normals to the fragment shader for interpolation.
                                                             // Transform the geometry's normals by the inverse transpose of the
                                                             // model matrix. This is necessary to ensure the normals remain
                                                             // perpendicular to the surface after the surface is transformed by
@@ -15,12 +15,22 @@ uniform mat4 u_Model;       // The matrix that defines the transformation of the
 uniform mat4 u_DepthVP;
 
 
-in vec4 vs_Pos;             // The array of vertex positions passed to the shader
+in uvec2 vs_Packed;         // A packed chunk vertex, laid out as described in chunkvertex.h
+
+// Indexed by the Direction enum in chunk.h
+const vec3 normals[6] = vec3[6](vec3(1, 0, 0), vec3(-1, 0, 0),
+                                vec3(0, 1, 0), vec3(0, -1, 0),
+                                vec3(0, 0, 1), vec3(0, 0, -1));
 
 out vec4 fs_Pos;
 
 void main()
 {
+    uint posNor = vs_Packed.x;
+    vec3 pos = vec3(posNor & 31u, (posNor >> 5u) & 511u, (posNor >> 14u) & 31u);
+    pos -= normals[(posNor >> 19u) & 7u] * float((posNor >> 22u) & 1u) / 16.0;
+    vec4 vs_Pos = vec4(pos, 1);
+
     vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
     fs_Pos = u_DepthVP * modelposition;// gl_Position is a built-in variable of OpenGL which is
                                              // used to render the final positions of the geometry's vertices
@@ -1,288 +1,266 @@
 #include "blocktypeworker.h"
 using namespace std;
-unordered_map<Biome, BlockType, hash<unsigned char>> BlockTypeWorker::m_topBlockMap = {
-    {ICE_SPIKES, SNOW},
-    {SWAMP, GRASS},
-    {ISLAND, GRASS},
-    {TUNDRA, SNOWGRASS},
-    {GRASSLAND, GRASS},
-    {VOLCANO, STONE},
-    {SHITLAND, SHIT},
-    {DESERT, SAND},
-    {DESERT_MOUNTAIN, SANDSTONE},
-};
-unordered_map<Biome, BlockType, hash<unsigned char>> BlockTypeWorker::m_fillBlockMap = {
-    {ICE_SPIKES, SNOW},
-    {SWAMP, DIRT},
-    {ISLAND, DIRT},
-    {TUNDRA, DIRT},
-    {GRASSLAND, DIRT},
-    {VOLCANO, STONE},
-    {SHITLAND, STONE},
-    {DESERT, SAND},
-    {DESERT_MOUNTAIN, SAND},
-};
 
-
-BlockTypeWorker::BlockTypeWorker(Terrain* t, std::unordered_set<int64_t> &genTer, QMutex* tm,
-                                 std::unordered_set<Chunk*> &chunks,
-                                 QMutex* bm, glm::ivec2 pos)
- : m_terrain(t), m_chunks(chunks), blockMux(bm), m_tZones(genTer),
-   tZonesMux(tm), m_pos(pos)
+BlockTypeWorker::BlockTypeWorker(Chunk* c, std::unordered_set<int64_t> &genTer,
+                                 std::unordered_map<int64_t, int> &zonesLeft, QMutex* tm,
+                                 MPSCQueue<Chunk*> &chunks, const HeightMap &heightMap,
+                                 CaveMode caves)
+ : m_chunk(c), m_chunks(chunks), m_tZones(genTer),
+   m_tZonesLeft(zonesLeft), tZonesMux(tm), m_heightMap(heightMap), m_caves(caves)
 {}
 
 void BlockTypeWorker::run() {
-    int x_pos = m_pos[0];
-    int z_pos = m_pos[1];
-
-    for (int x = x_pos; x < x_pos + 64; x += 16) {
-        for (int z = z_pos; z < z_pos + 64; z += 16) {
-            //load up each chunk
-            uPtr<Chunk>& m_chunk = m_terrain->getChunkAt(x,z);
-            for(int zl = 0; zl < 16; ++zl) {
-                for(int xl = 0; xl < 16; ++xl) {
-                    m_chunk->setBlockAt(xl,0,zl, BEDROCK);
-                }
-            }
-            //initialize stone separately to allow more efficient memory
-            // caching
-            for(int zl = 0; zl < 16; ++zl) {
-                for(int yl = 1; yl < 128; ++yl) {
-                    for(int xl = 0; xl < 16; ++xl) {
-                        //FOR CAVES
-                        //BlockType b = HeightMap::getDepth(x+xl,yl,z+zl);
-                        //m_chunk->setBlockAt(xl,yl,zl, b);
+    // Another job already generated this chunk
+    if (!m_chunk->transition(ALLOCATED, GENERATING)) {
+        finishZoneJob();
+        return;
+    }
+    int x = m_chunk->mcr_origin.x;
+    int z = m_chunk->mcr_origin.y;
 
-                        //FOR NO CAVES
-                        m_chunk->setBlockAt(xl,yl,zl, STONE);
+    m_chunk->fillLayers(0, 0, BEDROCK);
+    //initialize stone a whole section at a time so the
+    // sections between y = 16 and 127 stay uniform, then carve the caves
+    m_heightMap.carveCaves(m_chunk, m_caves);
+    boolean superChunk = m_heightMap.random1(x, z) < (1.f/200.f);
+    HeightTile ground;
+    m_heightMap.getHeightTile(x, z, ground);
+    for(int xl = 0; xl < 16; ++xl) {
+        for(int zl = 0; zl < 16; ++zl) {
+            int yMax = ground.height(xl, zl);
+            yMax = glm::clamp(yMax, 0, 254);
+            Biome b = ground.biome(xl, zl);
+            if (b == VOLCANO) {
+                if (yMax < 138) {
+                    for (int y = yMax; y <= 138; y++) {
+                        m_chunk->setBlockAt(xl, y, zl, WATER);
                     }
-
-                }
-            }
-            boolean superChunk = HeightMap::random1(x, z) < (1.f/200.f);
-            for(int xl = 0; xl < 16; ++xl) {
-                for(int zl = 0; zl < 16; ++zl) {
-                    std::pair<int, Biome> ground = HeightMap::getHeight(x + xl, z + zl);
-                    int yMax = ground.first;
-                    yMax = glm::clamp(0, 254, yMax);
-                    Biome b = ground.second;
-                    if (b == VOLCANO) {
-                        if (yMax < 138) {
-                            for (int y = yMax; y <= 138; y++) {
-                                m_chunk->setBlockAt(xl, y, zl, WATER);
-                            }
-                            for (int y = 128; y < yMax; y++) {
-                                m_chunk->setBlockAt(xl, y, zl, DIRT);
-                            }
-                        } else if (yMax < 144) {
-                            for (int y = 128; y < yMax; y++) {
-                                m_chunk->setBlockAt(xl, y, zl, DIRT);
-                            }
-                            m_chunk->setBlockAt(xl, yMax, zl, GRASS);
-                        } else if (yMax > 163) {
-                            for (int y = 128; y < 150; y++) {
-                                m_chunk->setBlockAt(xl, y, zl, LAVA);
-                            }
-
-                        } else {
-                            for (int y = 128; y < yMax; y++) {
-                                m_chunk->setBlockAt(xl, y, zl, m_fillBlockMap.at(b));
-                            }
-                            if (HeightMap::boulderHeight(x + xl, z + zl) > 0) {
-                                m_chunk->setBlockAt(xl, yMax, zl, OBSIDIAN);
-                            } else {
-                                m_chunk->setBlockAt(xl, yMax, zl, m_topBlockMap.at(b));
-                            }
-                        }
-                        continue;
+                    for (int y = 128; y < yMax; y++) {
+                        m_chunk->setBlockAt(xl, y, zl, DIRT);
                     }
-                    m_chunk->setBlockAt(xl, yMax, zl, m_topBlockMap.at(b));
-                    if(b == ICE_SPIKES || b == DESERT_MOUNTAIN) {
-                        for (int y = 128; y < yMax && y < 145; y++) {
-                            m_chunk->setBlockAt(xl, y, zl, m_fillBlockMap.at(b));
-                        }
-                        m_chunk->setBlockAt(xl, yMax, zl, m_fillBlockMap.at(b));
-                        for (int y = 145; y <= yMax; y++) {
-                            m_chunk->setBlockAt(xl, y, zl, m_topBlockMap.at(b));
-                        }
-                    } else {
-                        for (int y = 128; y < yMax; y++) {
-                            m_chunk->setBlockAt(xl, y, zl, m_fillBlockMap.at(b));
-                        }
+                } else if (yMax < 144) {
+                    for (int y = 128; y < yMax; y++) {
+                        m_chunk->setBlockAt(xl, y, zl, DIRT);
+                    }
+                    m_chunk->setBlockAt(xl, yMax, zl, GRASS);
+                } else if (yMax > 163) {
+                    for (int y = 128; y < 150; y++) {
+                        m_chunk->setBlockAt(xl, y, zl, LAVA);
                     }
 
-                    if (b == ISLAND && yMax < 140) {
-                        for (int y = 128; y <= yMax; y++) {
-                            m_chunk->setBlockAt(xl, y, zl, SAND);
-                        }
+                } else {
+                    for (int y = 128; y < yMax; y++) {
+                        m_chunk->setBlockAt(xl, y, zl, biomeProperties(b).fillBlock);
                     }
-                    if (yMax < 138) {
-                        for (int y = yMax; y <= 138; y++) {
-                            m_chunk->setBlockAt(xl, y, zl, WATER);
-                        }
-                        if(b == TUNDRA || b == ICE_SPIKES || b == SHITLAND) {
-                            m_chunk->setBlockAt(xl, 138, zl, ICE);
-                        }
+                    if (m_heightMap.boulderHeight(x + xl, z + zl) > 0) {
+                        m_chunk->setBlockAt(xl, yMax, zl, OBSIDIAN);
                     } else {
-                        if (b == DESERT && !superChunk && HeightMap::hasCactus(x + xl, z + zl)) {
-                            m_chunk->setBlockAt(xl, yMax+1, zl, CACTUS);
-                            m_chunk->setBlockAt(xl, yMax+2, zl, CACTUS);
-                            m_chunk->setBlockAt(xl, yMax+3, zl, CACTUS);
-                        }
-                        if (b == GRASSLAND && HeightMap::hasCactus(x + xl, z + zl) &&
-                                xl > 2 && zl > 2 && xl < 14 && zl < 14
-                                && HeightMap::random1(x + xl, z + zl) < 0.2) {
-                            for (int i = 0; i < 6; i++) {
-                                if (i == 4) {
-                                    for (int k = 0; k < 5; k++) {
-                                        for (int j = 0; j < 5; j++) {
-                                            m_chunk->setBlockAt(xl - 2 + k, yMax+i+1, zl - 2+j, LEAVES);
-                                        }
-                                    }
-                                }
-                                if (i == 5) {
-                                    for (int k = 0; k < 3; k++) {
-                                        for (int j = 0; j < 3; j++) {
-                                            m_chunk->setBlockAt(xl - 1 + k, yMax+i+1, zl -1+j, LEAVES);
-                                        }
-                                    }
+                        m_chunk->setBlockAt(xl, yMax, zl, biomeProperties(b).topBlock);
+                    }
+                }
+                continue;
+            }
+            m_chunk->setBlockAt(xl, yMax, zl, biomeProperties(b).topBlock);
+            if(b == ICE_SPIKES || b == DESERT_MOUNTAIN) {
+                for (int y = 128; y < yMax && y < 145; y++) {
+                    m_chunk->setBlockAt(xl, y, zl, biomeProperties(b).fillBlock);
+                }
+                m_chunk->setBlockAt(xl, yMax, zl, biomeProperties(b).fillBlock);
+                for (int y = 145; y <= yMax; y++) {
+                    m_chunk->setBlockAt(xl, y, zl, biomeProperties(b).topBlock);
+                }
+            } else {
+                for (int y = 128; y < yMax; y++) {
+                    m_chunk->setBlockAt(xl, y, zl, biomeProperties(b).fillBlock);
+                }
+            }
+
+            if (b == ISLAND && yMax < 140) {
+                for (int y = 128; y <= yMax; y++) {
+                    m_chunk->setBlockAt(xl, y, zl, SAND);
+                }
+            }
+            if (yMax < 138) {
+                for (int y = yMax; y <= 138; y++) {
+                    m_chunk->setBlockAt(xl, y, zl, WATER);
+                }
+                if(b == TUNDRA || b == ICE_SPIKES || b == SHITLAND) {
+                    m_chunk->setBlockAt(xl, 138, zl, ICE);
+                }
+            } else {
+                if (b == DESERT && !superChunk && m_heightMap.hasCactus(x + xl, z + zl)) {
+                    setDecorationAt(xl, yMax+1, zl, CACTUS);
+                    setDecorationAt(xl, yMax+2, zl, CACTUS);
+                    setDecorationAt(xl, yMax+3, zl, CACTUS);
+                }
+                if (b == GRASSLAND && m_heightMap.hasCactus(x + xl, z + zl) &&
+                        xl > 2 && zl > 2 && xl < 14 && zl < 14
+                        && m_heightMap.random1(x + xl, z + zl) < 0.2) {
+                    for (int i = 0; i < 6; i++) {
+                        if (i == 4) {
+                            for (int k = 0; k < 5; k++) {
+                                for (int j = 0; j < 5; j++) {
+                                    setDecorationAt(xl - 2 + k, yMax+i+1, zl - 2+j, LEAVES);
                                 }
-                                m_chunk->setBlockAt(xl, yMax+i+1, zl, WOOD);
                             }
-                            m_chunk->setBlockAt(xl, yMax+6+1, zl, LEAVES);
-
                         }
-                    }
-                    if (b == SHITLAND){
-                        for (int i = 0; i < HeightMap::boulderHeight(x + xl, z + zl); i++) {
-                            m_chunk->setBlockAt(xl, yMax+i+1, zl, COBBLE);
+                        if (i == 5) {
+                            for (int k = 0; k < 3; k++) {
+                                for (int j = 0; j < 3; j++) {
+                                    setDecorationAt(xl - 1 + k, yMax+i+1, zl -1+j, LEAVES);
+                                }
+                            }
                         }
+                        setDecorationAt(xl, yMax+i+1, zl, WOOD);
                     }
+                    setDecorationAt(xl, yMax+6+1, zl, LEAVES);
+
                 }
             }
-            std::pair<int, Biome> seed = HeightMap::getHeight(x + 8, z + 8);
-            int seedHeight = seed.first + 1;
-            Biome seedBiome = seed.second;
-            if (superChunk) {
-                if (seedBiome == DESERT) {
-                    //pyramid
-                    for(int zl = 0; zl < 15; ++zl) {
-                            for(int xl = 0; xl < 15; ++xl) {
-                                int layer = glm::min(glm::min(zl,xl), glm::min(14 - zl, 14 - xl)) + 1;
-                                for (int y = 0; y < layer; y++) {
-                                    m_chunk->setBlockAt(xl, y + seedHeight, zl, SANDSTONE);
-                                }
-                            }
-                    }
+            if (b == SHITLAND){
+                for (int i = 0; i < m_heightMap.boulderHeight(x + xl, z + zl); i++) {
+                    setDecorationAt(xl, yMax+i+1, zl, COBBLE);
                 }
-                if (seedBiome == TUNDRA) {
-                    //igloo
-                    std::array<int, 40> layer0x = {7, 8, 9,
-                                               7, 8, 9,
-                                               6, 7, 8, 9, 10,
-                                              5,6,7,8,9,10,11,
-                                              5,6,7,8,9,10,11,
-                                              5,6,7,8,9,10,11,
-                                              6,7,8,9,10,
-                                              7,8,9,};
-                    std::array<int, 17> layer1and2x = {7, 9,
-                                               7, 9,
-                                               6, 10,
-                                              5,11,
-                                              5,11,
-                                              5,11,
-                                              6,10,
-                                              7,8,9};
-                    std::array<int, 23> layer3x = {8,
-                                               8,
-                                               7, 8, 9,
-                                              6,7,8,9,10,
-                                              6,7,8,9,10,
-                                              6,7,8,9,10,
-                                              7,8,9,};
-                    std::array<int, 9> layer4x = {7,8,9,
-                                              7,8,9,
-                                              7,8,9,};
-                    std::array<int, 40> layer0z = {7,7,7,
-                                               8,8,8,
-                                               9,9,9,9,9,
-                                              10,10,10,10,10,10,10,
-                                              11,11,11,11,11,11,11,
-                                              12,12,12,12,12,12,12,
-                                              13,13,13,13,13,
-                                              14,14,14,};
-                    std::array<int, 17> layer1and2z = {7, 7,
-                                               8, 8,
-                                               9, 9,
-                                              10,10,
-                                              11,11,
-                                              12,12,
-                                              13,13,
-                                              14,14,14};
-                    std::array<int, 23> layer3z = {7,
-                                               8,
-                                               9, 9, 9,
-                                              10,10,10,10,10,
-                                              11,11,11,11,11,
-                                              12,12,12,12,12,
-                                              13,13,13,};
-                    std::array<int, 9> layer4z = {10,10,10,
-                                              11,11,11,
-                                              12,12,12,};
-                    for (int i = 0; i < 40; i++) {
-                        m_chunk->setBlockAt(layer0x[i], seedHeight - 1, layer0z[i], SNOW);
-                    }
-                    for (int j = 0; j < 2; j++) {
-                        for (int i = 0; i < 17; i++) {
-                            m_chunk->setBlockAt(layer1and2x[i], seedHeight + j, layer1and2z[i], SNOW);
+            }
+        }
+    }
+    int seedHeight = ground.height(8, 8) + 1;
+    Biome seedBiome = ground.biome(8, 8);
+    if (superChunk) {
+        if (seedBiome == DESERT) {
+            //pyramid
+            for(int zl = 0; zl < 15; ++zl) {
+                    for(int xl = 0; xl < 15; ++xl) {
+                        int layer = glm::min(glm::min(zl,xl), glm::min(14 - zl, 14 - xl)) + 1;
+                        for (int y = 0; y < layer; y++) {
+                            setDecorationAt(xl, y + seedHeight, zl, SANDSTONE);
                         }
-
-                    }
-                    for (int i = 0; i < 23; i++) {
-                        m_chunk->setBlockAt(layer3x[i], seedHeight+2, layer3z[i], SNOW);
-                    }
-                    for (int i = 0; i < 9; i++) {
-                        m_chunk->setBlockAt(layer4x[i], seedHeight+3, layer4z[i], SNOW);
                     }
+            }
+        }
+        if (seedBiome == TUNDRA) {
+            //igloo
+            std::array<int, 40> layer0x = {7, 8, 9,
+                                       7, 8, 9,
+                                       6, 7, 8, 9, 10,
+                                      5,6,7,8,9,10,11,
+                                      5,6,7,8,9,10,11,
+                                      5,6,7,8,9,10,11,
+                                      6,7,8,9,10,
+                                      7,8,9,};
+            std::array<int, 17> layer1and2x = {7, 9,
+                                       7, 9,
+                                       6, 10,
+                                      5,11,
+                                      5,11,
+                                      5,11,
+                                      6,10,
+                                      7,8,9};
+            std::array<int, 23> layer3x = {8,
+                                       8,
+                                       7, 8, 9,
+                                      6,7,8,9,10,
+                                      6,7,8,9,10,
+                                      6,7,8,9,10,
+                                      7,8,9,};
+            std::array<int, 9> layer4x = {7,8,9,
+                                      7,8,9,
+                                      7,8,9,};
+            std::array<int, 40> layer0z = {7,7,7,
+                                       8,8,8,
+                                       9,9,9,9,9,
+                                      10,10,10,10,10,10,10,
+                                      11,11,11,11,11,11,11,
+                                      12,12,12,12,12,12,12,
+                                      13,13,13,13,13,
+                                      14,14,14,};
+            std::array<int, 17> layer1and2z = {7, 7,
+                                       8, 8,
+                                       9, 9,
+                                      10,10,
+                                      11,11,
+                                      12,12,
+                                      13,13,
+                                      14,14,14};
+            std::array<int, 23> layer3z = {7,
+                                       8,
+                                       9, 9, 9,
+                                      10,10,10,10,10,
+                                      11,11,11,11,11,
+                                      12,12,12,12,12,
+                                      13,13,13,};
+            std::array<int, 9> layer4z = {10,10,10,
+                                      11,11,11,
+                                      12,12,12,};
+            for (int i = 0; i < 40; i++) {
+                setDecorationAt(layer0x[i], seedHeight - 1, layer0z[i], SNOW);
+            }
+            for (int j = 0; j < 2; j++) {
+                for (int i = 0; i < 17; i++) {
+                    setDecorationAt(layer1and2x[i], seedHeight + j, layer1and2z[i], SNOW);
                 }
-                if (seedBiome == SHITLAND) {
-                    //igloo
-                    std::array<int, 16> layer1to4x = {5,6,10,11,
-                                                      5,6,10,11,
-                                                      5,6,10,11,
-                                                      5,6,10,11};
-                    std::array<int, 14> layer5x = {6,7,8,9,10,
-                                                   6,10,
-                                                   6,10,
-                                                   6,7,8,9,10,};
-                    std::array<int, 16> layer1to4z = {8,8,8,8,
-                                                      9,9,9,9,
-                                                      12,12,12,12,
-                                                      13,13,13,13};
-                    std::array<int, 14> layer5z = {9,9,9,9,9,
-                                                   10,10,
-                                                   11,11,
-                                                   12,12,12,12};
-                    for (int j = 0; j < 4; j++) {
-                        for (int i = 0; i < 16; i++) {
-                            m_chunk->setBlockAt(layer1to4x[i], seedHeight, layer1to4z[i], STONE);
-                        }
 
-                    }
-                    for (int i = 0; i < 14; i++) {
-                        m_chunk->setBlockAt(layer5x[i], seedHeight + 4, layer5z[i], OBSIDIAN);
-                    }
-                }
             }
-            m_chunk->m_blocksFilled = true;
+            for (int i = 0; i < 23; i++) {
+                setDecorationAt(layer3x[i], seedHeight+2, layer3z[i], SNOW);
+            }
+            for (int i = 0; i < 9; i++) {
+                setDecorationAt(layer4x[i], seedHeight+3, layer4z[i], SNOW);
+            }
+        }
+        if (seedBiome == SHITLAND) {
+            //igloo
+            std::array<int, 16> layer1to4x = {5,6,10,11,
+                                              5,6,10,11,
+                                              5,6,10,11,
+                                              5,6,10,11};
+            std::array<int, 14> layer5x = {6,7,8,9,10,
+                                           6,10,
+                                           6,10,
+                                           6,7,8,9,10,};
+            std::array<int, 16> layer1to4z = {8,8,8,8,
+                                              9,9,9,9,
+                                              12,12,12,12,
+                                              13,13,13,13};
+            std::array<int, 14> layer5z = {9,9,9,9,9,
+                                           10,10,
+                                           11,11,
+                                           12,12,12,12};
+            for (int j = 0; j < 4; j++) {
+                for (int i = 0; i < 16; i++) {
+                    setDecorationAt(layer1to4x[i], seedHeight, layer1to4z[i], STONE);
+                }
 
-            // let generated terrain know chunk block data is generated.
-            blockMux->lock();
-            m_chunks.insert(m_chunk.get());
-            blockMux->unlock();
+            }
+            for (int i = 0; i < 14; i++) {
+                setDecorationAt(layer5x[i], seedHeight + 4, layer5z[i], OBSIDIAN);
+            }
         }
     }
+    m_chunk->compact();
+    m_chunk->rebuildColumnData();
+    m_chunk->setGround(ground);
+    m_chunk->transition(GENERATING, GENERATED);
+
+    // let generated terrain know chunk block data is generated.
+    m_chunks.push(m_chunk);
+    finishZoneJob();
+}
+
+void BlockTypeWorker::setDecorationAt(int x, int y, int z, BlockType t) {
+    if (y < 0 || y > 255) {
+        return;
+    }
+    m_chunk->setBlockAt(x, y, z, t);
+}
+
+// The last of a zone's jobs to finish marks the whole zone generated
+void BlockTypeWorker::finishZoneJob() {
+    int64_t zone = Terrain::zoneOf(m_chunk->mcr_origin.x, m_chunk->mcr_origin.y);
     tZonesMux->lock();
-    m_tZones.insert(Terrain::toKey(x_pos, z_pos));
+    if (--m_tZonesLeft[zone] == 0) {
+        m_tZonesLeft.erase(zone);
+        m_tZones.insert(zone);
+    }
     tZonesMux->unlock();
 }
@@ -3,25 +3,39 @@
 #include <QMutex>
 #include <unordered_set>
 #include "scene/terrain.h"
+#include "mpscqueue.h"
 using namespace std;
 
 class Chunk;
 class Terrain;
+class HeightMap;
 enum BlockType: unsigned char;
 enum Biome: unsigned char;
+enum CaveMode: unsigned char;
+// Fills the blocks of a single chunk
 class BlockTypeWorker : public QRunnable {
 private:
-    Terrain* m_terrain;
-    std::unordered_set<Chunk*>& m_chunks;
-    QMutex *blockMux;
+    Chunk* m_chunk;
+    MPSCQueue<Chunk*>& m_chunks;
     std::unordered_set<int64_t>& m_tZones;
+    // Chunks of each zone not generated yet, guarded by tZonesMux. Each
+    // queued job holds one count for its chunk, including a job requeued
+    // after being dropped, which takes over the dropped job's count.
+    std::unordered_map<int64_t, int>& m_tZonesLeft;
     QMutex *tZonesMux;
-    glm::ivec2 m_pos;
-    static unordered_map<Biome, BlockType, hash<unsigned char>> m_fillBlockMap;
+    // The noise of the chunk's world
+    const HeightMap &m_heightMap;
+    CaveMode m_caves;
+
+    // Writes a block of a tree, cactus, boulder or structure, leaving out
+    // the parts that stick out of the top of the world
+    void setDecorationAt(int x, int y, int z, BlockType t);
+    // Counts this job off its zone's m_tZonesLeft, on every way out of run()
+    void finishZoneJob();
 
 public:
-    static unordered_map<Biome, BlockType, hash<unsigned char>> m_topBlockMap;
-    BlockTypeWorker(Terrain*, std::unordered_set<int64_t> &, QMutex*,
-                    std::unordered_set<Chunk*> &, QMutex*, glm::ivec2);
+    BlockTypeWorker(Chunk*, std::unordered_set<int64_t> &,
+                    std::unordered_map<int64_t, int> &, QMutex*,
+                    MPSCQueue<Chunk*> &, const HeightMap &, CaveMode);
     void run() override;
 };
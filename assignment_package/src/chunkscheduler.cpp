@@ -0,0 +1,78 @@
+#include "chunkscheduler.h"
+#include <algorithm>
+
+namespace {
+// Lower runs sooner. Distance to the player, with jobs behind the
+// player's view counted as up to twice as far away as ones in front.
+float urgency(const ScheduledJob &j, glm::vec2 pos, glm::vec2 forward) {
+    glm::vec2 toJob = j.m_center - pos;
+    float dist = glm::length(toJob);
+    float facing = dist > 0.f ? glm::dot(toJob / dist, forward) : 1.f;
+    return dist * (1.5f - 0.5f * facing);
+}
+}
+
+ScheduledJob::ScheduledJob(sPtr<Task> task, JobType type, Chunk *chunk, int64_t zone, glm::vec2 center)
+    : mp_task(std::move(task)), m_type(type), mp_chunk(chunk), m_zone(zone), m_center(center)
+{}
+
+ChunkScheduler::ChunkScheduler(JobSystem &jobs)
+    : m_jobs(jobs), m_pending()
+{}
+
+void ChunkScheduler::enqueue(sPtr<Task> task, JobType type, Chunk *chunk, int64_t zone, glm::vec2 center) {
+    m_pending.emplace_back(std::move(task), type, chunk, zone, center);
+}
+
+std::vector<Chunk*> ChunkScheduler::dropUnwanted(const QSet<int64_t> &wantedZones) {
+    std::vector<Chunk*> droppedGenerations;
+    auto unwanted = [&](const ScheduledJob &j) {
+        if (wantedZones.contains(j.m_zone)) {
+            return false;
+        }
+        if (j.m_type == GENERATE) {
+            droppedGenerations.push_back(j.mp_chunk);
+        }
+        m_jobs.cancel(j.mp_task);
+        return true;
+    };
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), unwanted),
+                    m_pending.end());
+    return droppedGenerations;
+}
+
+void ChunkScheduler::dispatch(glm::vec3 pos, glm::vec3 forward) {
+    // One task queued behind each running one, so that a worker finishing
+    // a chunk between two ticks moves on to the next instead of idling
+    int free = 2 * m_jobs.threadCount() - m_jobs.activeCount();
+    if (free <= 0 || m_pending.empty()) {
+        return;
+    }
+
+    glm::vec2 pos2(pos.x, pos.z);
+    glm::vec2 forward2(forward.x, forward.z);
+    if (glm::length(forward2) > 0.f) {
+        forward2 = glm::normalize(forward2);
+    }
+    std::stable_sort(m_pending.begin(), m_pending.end(),
+                     [&](const ScheduledJob &a, const ScheduledJob &b) {
+        return urgency(a, pos2, forward2) < urgency(b, pos2, forward2);
+    });
+
+    int n = std::min(free, static_cast<int>(m_pending.size()));
+    for (int i = 0; i < n; i++) {
+        m_jobs.submit(m_pending[i].mp_task);
+    }
+    m_pending.erase(m_pending.begin(), m_pending.begin() + n);
+}
+
+void ChunkScheduler::dispatchAll() {
+    for (ScheduledJob &j : m_pending) {
+        m_jobs.submit(j.mp_task);
+    }
+    m_pending.clear();
+}
+
+int ChunkScheduler::pendingCount() const {
+    return m_pending.size();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <QSet>
+#include <vector>
+#include "glm_includes.h"
+#include "smartpointerhelp.h"
+#include "jobsystem.h"
+
+class Chunk;
+
+enum JobType : unsigned char
+{
+    GENERATE, MESH
+};
+
+// A generation or meshing task waiting to be submitted
+struct ScheduledJob {
+    sPtr<Task> mp_task;
+    JobType m_type;
+    // The chunk the job generates or meshes
+    Chunk *mp_chunk;
+    // The terrain generation zone the job works in
+    int64_t m_zone;
+    // World-space x and z of the center of the area the job works on
+    glm::vec2 m_center;
+
+    ScheduledJob(sPtr<Task> task, JobType type, Chunk *chunk, int64_t zone, glm::vec2 center);
+};
+
+// Submits generation and meshing tasks to a JobSystem, nearest and most in
+// view of the player first. Tasks wait here instead of in the job system
+// and are only submitted when a worker is nearly free, so the ones still
+// waiting are re-ordered every tick as the player moves, and can be dropped
+// once the player has left their zone.
+class ChunkScheduler {
+private:
+    JobSystem &m_jobs;
+    std::vector<ScheduledJob> m_pending;
+
+public:
+    explicit ChunkScheduler(JobSystem &jobs);
+
+    void enqueue(sPtr<Task> task, JobType type, Chunk *chunk, int64_t zone, glm::vec2 center);
+    // Cancels every waiting task whose zone is not in wantedZones, which
+    // releases the tasks waiting on it. Returns the chunks whose generation
+    // tasks were cancelled.
+    std::vector<Chunk*> dropUnwanted(const QSet<int64_t> &wantedZones);
+    // Submits the most urgent waiting tasks until every worker is busy
+    // and has one more task queued
+    void dispatch(glm::vec3 pos, glm::vec3 forward);
+    // Submits every waiting task, for when the caller is about to wait on
+    // the job system
+    void dispatchAll();
+
+    int pendingCount() const;
+};
@@ -41,6 +41,11 @@ int Drawable::elemCount()
     return m_count;
 }
 
+int Drawable::elemCountT()
+{
+    return m_countT;
+}
+
 void Drawable::generateIdx()
 {
     m_idxGenerated = true;
@@ -0,0 +1,190 @@
+#include "jobsystem.h"
+#include <algorithm>
+
+namespace {
+// The job system and worker index of the worker running on this thread
+thread_local JobSystem *t_system = nullptr;
+thread_local int t_worker = -1;
+}
+
+Task::Task(QRunnable *job, TaskLane lane)
+    : mp_job(job), m_lane(lane), m_waitingOn(1), m_mux(), m_finished(false), m_dependents()
+{}
+
+JobSystem::JobSystem(int threads, size_t mainCapacity)
+    : m_workers(), m_threads(), m_mux(), m_urgent(), m_injected(), m_wake(), m_idle(),
+      m_queued(0), m_running(0), m_stopping(false), m_mainTasks(mainCapacity)
+{
+    threads = std::max(threads, 1);
+    for (int i = 0; i < threads; i++) {
+        m_workers.push_back(mkU<Worker>());
+    }
+    for (int i = 0; i < threads; i++) {
+        m_threads.emplace_back(&JobSystem::work, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    m_mux.lock();
+    m_stopping = true;
+    m_wake.wakeAll();
+    m_mux.unlock();
+    for (std::thread &t : m_threads) {
+        t.join();
+    }
+}
+
+void JobSystem::work(int index) {
+    t_system = this;
+    t_worker = index;
+    while (!m_stopping) {
+        sPtr<Task> t = take(index);
+        if (t == nullptr) {
+            QMutexLocker locker(&m_mux);
+            while (m_queued == 0 && !m_stopping) {
+                m_wake.wait(&m_mux);
+            }
+            continue;
+        }
+        t->mp_job->run();
+        t->mp_job.reset();
+        finish(t);
+        // After finish, so that the tasks it made ready are counted first
+        if (--m_running == 0 && m_queued == 0) {
+            QMutexLocker locker(&m_mux);
+            m_idle.wakeAll();
+        }
+    }
+}
+
+sPtr<Task> JobSystem::take(int index) {
+    sPtr<Task> t;
+    auto popFront = [&](std::deque<sPtr<Task>> &q) {
+        if (!q.empty()) {
+            t = std::move(q.front());
+            q.pop_front();
+        }
+    };
+    m_mux.lock();
+    popFront(m_urgent);
+    m_mux.unlock();
+
+    if (t == nullptr) {
+        Worker &own = *m_workers[index];
+        QMutexLocker locker(&own.mux);
+        if (!own.tasks.empty()) {
+            t = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; t == nullptr && i < m_workers.size(); i++) {
+        Worker &victim = *m_workers[(index + i) % m_workers.size()];
+        QMutexLocker locker(&victim.mux);
+        popFront(victim.tasks);
+    }
+    if (t == nullptr) {
+        m_mux.lock();
+        popFront(m_injected);
+        m_mux.unlock();
+    }
+
+    if (t != nullptr) {
+        // Counted as running before it stops counting as queued, so that
+        // waitForDone never sees both at 0 in between
+        m_running++;
+        m_queued--;
+    }
+    return t;
+}
+
+void JobSystem::enqueue(const sPtr<Task> &t) {
+    if (t->m_lane == MAIN_LANE) {
+        m_mainTasks.push(t);
+        return;
+    }
+    if (t->m_lane == WORKER_LANE && t_system == this) {
+        Worker &own = *m_workers[t_worker];
+        QMutexLocker locker(&own.mux);
+        own.tasks.push_back(t);
+        m_queued++;
+    } else {
+        QMutexLocker locker(&m_mux);
+        (t->m_lane == URGENT_LANE ? m_urgent : m_injected).push_back(t);
+        m_queued++;
+    }
+    QMutexLocker locker(&m_mux);
+    m_wake.wakeOne();
+}
+
+void JobSystem::release(const sPtr<Task> &t) {
+    if (--t->m_waitingOn == 0) {
+        enqueue(t);
+    }
+}
+
+void JobSystem::finish(const sPtr<Task> &t) {
+    std::vector<sPtr<Task>> dependents;
+    t->m_mux.lock();
+    t->m_finished = true;
+    dependents.swap(t->m_dependents);
+    t->m_mux.unlock();
+    for (const sPtr<Task> &d : dependents) {
+        release(d);
+    }
+}
+
+bool JobSystem::addDependency(const sPtr<Task> &before, const sPtr<Task> &after) {
+    // Cancelled, so it never becomes ready
+    after->m_mux.lock();
+    bool cancelled = after->m_finished;
+    after->m_mux.unlock();
+    if (cancelled) {
+        return false;
+    }
+    QMutexLocker locker(&before->m_mux);
+    if (before->m_finished) {
+        return true;
+    }
+    // Once a task is ready its count never rises again
+    int waiting = after->m_waitingOn;
+    do {
+        if (waiting == 0) {
+            return false;
+        }
+    } while (!after->m_waitingOn.compare_exchange_weak(waiting, waiting + 1));
+    before->m_dependents.push_back(after);
+    return true;
+}
+
+void JobSystem::submit(const sPtr<Task> &t) {
+    release(t);
+}
+
+void JobSystem::cancel(const sPtr<Task> &t) {
+    t->mp_job.reset();
+    finish(t);
+}
+
+void JobSystem::runMainTasks() {
+    sPtr<Task> t;
+    while (m_mainTasks.tryPop(t)) {
+        t->mp_job->run();
+        t->mp_job.reset();
+        finish(t);
+    }
+}
+
+void JobSystem::waitForDone() {
+    QMutexLocker locker(&m_mux);
+    while (m_queued > 0 || m_running > 0) {
+        m_idle.wait(&m_mux);
+    }
+}
+
+int JobSystem::threadCount() const {
+    return static_cast<int>(m_threads.size());
+}
+
+int JobSystem::activeCount() const {
+    return m_queued + m_running;
+}
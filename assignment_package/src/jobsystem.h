@@ -0,0 +1,101 @@
+#pragma once
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+#include "smartpointerhelp.h"
+#include "mpscqueue.h"
+
+// Where a task runs once every task it waits on has finished
+enum TaskLane : unsigned char
+{
+    // On any worker thread
+    WORKER_LANE,
+    // On a worker thread, ahead of every WORKER_LANE task
+    URGENT_LANE,
+    // On the main thread, when it calls JobSystem::runMainTasks
+    MAIN_LANE
+};
+
+// One node of a job graph: a job, and the tasks waiting on it to finish
+class Task {
+    friend class JobSystem;
+private:
+    uPtr<QRunnable> mp_job;
+    TaskLane m_lane;
+    // The tasks this one waits on that have not finished, plus one held by
+    // whoever builds it until it is submitted. It is ready at 0.
+    std::atomic<int> m_waitingOn;
+    // Guards m_finished and m_dependents
+    QMutex m_mux;
+    bool m_finished;
+    std::vector<sPtr<Task>> m_dependents;
+
+public:
+    // Takes ownership of job
+    Task(QRunnable *job, TaskLane lane);
+};
+
+// Runs task graphs on its own worker threads. Each worker keeps the tasks
+// made ready by the tasks it ran in a deque of its own, running the
+// newest first, and takes the oldest from another worker's deque when
+// its own is empty. Tasks made ready on other threads are shared by all
+// of the workers.
+class JobSystem {
+private:
+    struct Worker {
+        QMutex mux;
+        std::deque<sPtr<Task>> tasks;
+    };
+
+    std::vector<uPtr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    // Guards the two queues below and the waits on the conditions
+    QMutex m_mux;
+    std::deque<sPtr<Task>> m_urgent;
+    std::deque<sPtr<Task>> m_injected;
+    QWaitCondition m_wake;
+    QWaitCondition m_idle;
+    // Ready tasks no worker has taken yet, and tasks being run
+    std::atomic<int> m_queued;
+    std::atomic<int> m_running;
+    std::atomic<bool> m_stopping;
+    // Ready MAIN_LANE tasks
+    MPSCQueue<sPtr<Task>> m_mainTasks;
+
+    void work(int index);
+    // The next task for worker index to run, or nullptr if there is none
+    sPtr<Task> take(int index);
+    void enqueue(const sPtr<Task> &t);
+    // Drops one of the waits of t, enqueueing it once it has none left
+    void release(const sPtr<Task> &t);
+    // Marks t finished and releases the tasks waiting on it
+    void finish(const sPtr<Task> &t);
+
+public:
+    // mainCapacity must hold every MAIN_LANE task that may become ready
+    // before the main thread next calls runMainTasks
+    JobSystem(int threads, size_t mainCapacity);
+    // Waits for the running tasks, dropping the rest
+    ~JobSystem();
+
+    // Makes after wait until before has finished. Returns false, without
+    // adding the wait, if after is already ready or was cancelled; true if
+    // before has already finished.
+    bool addDependency(const sPtr<Task> &before, const sPtr<Task> &after);
+    // Lets t run once every task it waits on has finished
+    void submit(const sPtr<Task> &t);
+    // Finishes an unsubmitted task without running it
+    void cancel(const sPtr<Task> &t);
+    // Runs the MAIN_LANE tasks that are ready
+    void runMainTasks();
+    // Blocks until no task is ready or running on the workers
+    void waitForDone();
+
+    int threadCount() const;
+    // Tasks ready or running on the workers
+    int activeCount() const;
+};
@@ -8,9 +8,9 @@ Lsystem::Lsystem(std::string init) :
     lstring(init)
 {}
 
-void Lsystem::constructLString(int iterations, float prob, float branch) {
+void Lsystem::constructLString(int iterations, float prob, float branch, CounterRng &rng) {
     for (int i=0; i<iterations; i++) {
-        lstring = replaceF(lstring, std::string("F"), prob, branch);
+        lstring = replaceF(lstring, std::string("F"), prob, branch, rng);
         lstring = replaceLR(lstring);
     }
 }
@@ -32,13 +32,13 @@ std::string Lsystem::replaceLR(std::string str) {
     return str;
 }
 
-std::string Lsystem::replaceF(std::string str, std::string from, float prob, float branch) {
+std::string Lsystem::replaceF(std::string str, std::string from, float prob, float branch, CounterRng &rng) {
     //copied from https://stackoverflow.com/questions/2896600/how-to-replace-all-occurrences-of-a-character-in-string
     size_t start_pos = 0;
     while((start_pos = str.find(from, start_pos)) != std::string::npos) {
-        float p = ((float) rand() / (RAND_MAX));
-        float i = ((float) rand() / (RAND_MAX));
-        int index = i > branch ? 0 : std::floor(1 + ((float) rand() / (RAND_MAX)) * 2);
+        float p = rng.nextFloat();
+        float i = rng.nextFloat();
+        int index = i > branch ? 0 : std::floor(1 + rng.nextFloat() * 2);
         std::string to = rules[index];
         if (p > prob) {
             str.replace(start_pos, from.length(), to);
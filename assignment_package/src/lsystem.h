@@ -5,14 +5,17 @@
 #include <math.h>
 #include <iostream>
 #include <glm_includes.h>
+#include "scene/counterrng.h"
 
 class Lsystem {
 public:
     std::string lstring;
     std::vector<std::string> rules;
 
-    void constructLString(int, float, float);
-    std::string replaceF(std::string, std::string, float, float);
+    // Draws its random choices from rng, so that the same stream always
+    // grows the same string
+    void constructLString(int, float, float, CounterRng &rng);
+    std::string replaceF(std::string, std::string, float, float, CounterRng &rng);
     std::string replaceLR(std::string);
     Lsystem();
     Lsystem(std::string);
@@ -0,0 +1,44 @@
+#include "meshbufferpool.h"
+#include <QMutexLocker>
+
+MeshBufferPool::MeshBufferPool()
+    : m_mutex(), m_free()
+{}
+
+std::vector<ChunkVertex> MeshBufferPool::acquire(size_t vertices) {
+    std::vector<ChunkVertex> buffer;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (!m_free.empty()) {
+            buffer = std::move(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    buffer.reserve(vertices);
+    return buffer;
+}
+
+void MeshBufferPool::release(std::vector<ChunkVertex> &&buffer) {
+    if (buffer.capacity() == 0) {
+        return;
+    }
+    buffer.clear();
+    QMutexLocker lock(&m_mutex);
+    if (m_free.size() < MAX_POOLED) {
+        m_free.push_back(std::move(buffer));
+    }
+}
+
+size_t MeshBufferPool::pooledCount() const {
+    QMutexLocker lock(&m_mutex);
+    return m_free.size();
+}
+
+size_t MeshBufferPool::pooledCapacity() const {
+    QMutexLocker lock(&m_mutex);
+    size_t vertices = 0;
+    for (const std::vector<ChunkVertex> &b : m_free) {
+        vertices += b.capacity();
+    }
+    return vertices;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <QMutex>
+#include <cstddef>
+#include <vector>
+#include "scene/chunkvertex.h"
+
+// Vertex buffers for chunk meshes. A buffer keeps its capacity when it is
+// handed back after its mesh is uploaded or dropped, and the next mesh job
+// reuses it, so that meshing allocates almost nothing once the pool has
+// grown to the number of meshes in flight.
+// Buffers are taken on pool threads and handed back on the main thread,
+// so the free list is shared; the lock is only held to move a buffer
+// in or out of it.
+class MeshBufferPool {
+private:
+    mutable QMutex m_mutex;
+    std::vector<std::vector<ChunkVertex>> m_free;
+
+public:
+    // More free buffers than this are released to the allocator
+    static constexpr size_t MAX_POOLED = 256;
+
+    MeshBufferPool();
+
+    // An empty buffer with room for at least `vertices` vertices
+    std::vector<ChunkVertex> acquire(size_t vertices);
+    // Takes back a buffer that is no longer needed
+    void release(std::vector<ChunkVertex> &&buffer);
+
+    // Free buffers, and the vertices they have room for in total
+    size_t pooledCount() const;
+    size_t pooledCapacity() const;
+};
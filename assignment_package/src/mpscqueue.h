@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include "smartpointerhelp.h"
+
+// A bounded queue that any number of threads may push to while a single
+// thread pops, without locks. Workers use it to hand their results to
+// the main thread, so that neither side ever waits on a mutex the other
+// holds while it does real work.
+//
+// Each cell carries a sequence number that tells producers and the
+// consumer whose turn it is: a cell at position p may be written when its
+// sequence is p, and read when it is p + 1. Producers claim positions by
+// advancing m_tail with a compare-and-swap; only the consumer touches m_head.
+template<typename T>
+class MPSCQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    uPtr<Cell[]> m_cells;
+    size_t m_mask;
+    // Kept on separate cache lines so producers and consumer don't
+    // invalidate each other's
+    alignas(64) std::atomic<size_t> m_tail;
+    alignas(64) size_t m_head;
+
+public:
+    // capacity is rounded up to a power of two
+    explicit MPSCQueue(size_t capacity);
+
+    // Moves v into the queue, or returns false and leaves v alone if the
+    // queue is full
+    bool tryPush(T &v);
+    // Like tryPush, but yields and retries while the queue is full
+    void push(T v);
+    // Only ever called from the consumer thread
+    bool tryPop(T &out);
+};
+
+template<typename T>
+MPSCQueue<T>::MPSCQueue(size_t capacity)
+    : m_cells(), m_mask(0), m_tail(0), m_head(0)
+{
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_cells = uPtr<Cell[]>(new Cell[size]);
+    for (size_t i = 0; i < size; i++) {
+        m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    m_mask = size - 1;
+}
+
+template<typename T>
+bool MPSCQueue<T>::tryPush(T &v) {
+    size_t pos = m_tail.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+        cell = &m_cells[pos & m_mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The consumer has not emptied this cell since the last lap
+            return false;
+        } else {
+            // Another producer claimed pos first
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+    cell->value = std::move(v);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+void MPSCQueue<T>::push(T v) {
+    while (!tryPush(v)) {
+        std::this_thread::yield();
+    }
+}
+
+template<typename T>
+bool MPSCQueue<T>::tryPop(T &out) {
+    Cell &cell = m_cells[m_head & m_mask];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (seq != m_head + 1) {
+        return false;
+    }
+    out = std::move(cell.value);
+    // Hand the cell back to producers for the next lap
+    cell.seq.store(m_head + m_mask + 1, std::memory_order_release);
+    m_head++;
+    return true;
+}
@@ -5,6 +5,20 @@
 #include <QApplication>
 #include <QKeyEvent>
 
+namespace {
+// MINI_MINECRAFT_CAVES=exact or fast carves caves into the world. Caves
+// are off otherwise, since they slow generation down.
+CaveMode caveModeFromEnvironment() {
+    QByteArray caves = qgetenv("MINI_MINECRAFT_CAVES");
+    if (caves == "exact") {
+        return EXACT_CAVES;
+    }
+    if (caves == "fast") {
+        return FAST_CAVES;
+    }
+    return NO_CAVES;
+}
+}
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
@@ -13,7 +27,7 @@ MyGL::MyGL(QWidget *parent)
       m_progShadows(this), m_postProcess(this), frameBuff(this, width()*devicePixelRatio(), height()*devicePixelRatio(), devicePixelRatio()),
       shadowMap(this, 1024, 1024, 1),
       m_geomQuad(this),
-      m_terrain(this), m_player(glm::vec3(48.f, 140.f, 48.f), m_terrain),
+      m_terrain(this, caveModeFromEnvironment(), qgetenv("MINI_MINECRAFT_SEED").toULongLong()), m_player(glm::vec3(48.f, 140.f, 48.f), m_terrain),
 
       currentT(QDateTime::currentMSecsSinceEpoch()), shaderT(0.f)
 {
@@ -21,6 +35,13 @@ MyGL::MyGL(QWidget *parent)
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
     // Tell the timer to redraw 60 times per second
     m_timer.start(16);
+    // The per-tick mesh upload budget, for tuning it against the upload
+    // stats the P key prints. Unset values keep the terrain's defaults.
+    bool msSet = false, kbSet = false;
+    float uploadMs = qgetenv("MINI_MINECRAFT_UPLOAD_MS").toFloat(&msSet);
+    qulonglong uploadKB = qgetenv("MINI_MINECRAFT_UPLOAD_KB").toULongLong(&kbSet);
+    m_terrain.setUploadBudget(msSet ? uploadMs : m_terrain.uploadBudgetMs(),
+                              kbSet ? uploadKB * 1024 : m_terrain.uploadBudgetBytes());
     setFocusPolicy(Qt::ClickFocus);
 
     setMouseTracking(true); // MyGL will track the mouse's movements even if a mouse button is not pressed
@@ -137,7 +158,7 @@ void MyGL::tick() {
     m_progLambert.setTime(shaderT);
 
     m_player.tick(dt, m_inputs);
-    m_terrain.multiThreadedWork(m_player.mcr_position, m_player.mcr_posPrev, dt);
+    m_terrain.multiThreadedWork(m_player.mcr_position, m_player.mcr_forward, dt);
     //m_inputs = InputBundle(); //reset input bundle
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
     sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
@@ -251,6 +272,15 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
         m_player.flight = !m_player.flight;
     } else if (e->key() == Qt::Key_Space) {
         m_inputs.spacePressed = true;
+    } else if (e->key() == Qt::Key_G) {
+        // Switch between the per-face and greedy meshers
+        m_terrain.setMeshMode(m_terrain.meshMode() == GREEDY ? PER_FACE : GREEDY);
+    } else if (e->key() == Qt::Key_P) {
+        // Print the geometry each mesher has produced, upload and edit
+        // timings, and how many chunks are in each lifecycle state
+        m_terrain.printMeshStats();
+        m_terrain.printUploadStats();
+        m_terrain.printChunkStates();
     }
 }
 
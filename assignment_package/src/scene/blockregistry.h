@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <cstddef>
+
+// C++ 11 allows us to define the size of an enum. This lets us use only one byte
+// of memory to store our different block types. By default, the size of a C++ enum
+// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
+// block types, but in the scope of this project we'll never get anywhere near that many.
+// A new block type also needs an entry at the same position in BLOCKS below.
+enum BlockType : unsigned char
+{
+    EMPTY, GRASS, SNOWGRASS, DIRT, STONE, WATER, SNOW, LAVA, BEDROCK, ICE,
+    SAND, SANDSTONE, OBSIDIAN, CACTUS, COBBLE, WOOD, LEAVES, SHIT
+};
+constexpr std::size_t BLOCK_TYPE_COUNT = SHIT + 1;
+
+// A new biome also needs an entry at the same position in BIOMES below
+enum Biome : unsigned char {
+    ICE_SPIKES, SWAMP, ISLAND, TUNDRA, GRASSLAND, VOLCANO,
+    SHITLAND, DESERT, DESERT_MOUNTAIN
+};
+constexpr std::size_t BIOME_COUNT = DESERT_MOUNTAIN + 1;
+
+// Column and row of a 16 x 16 texture tile in the block atlas,
+// counted from its lower left corner
+struct AtlasTile {
+    unsigned char x;
+    unsigned char y;
+};
+
+// Everything the mesher, the terrain generator and the player's physics
+// need to know about a block type
+struct BlockProperties {
+    BlockType type;
+    const char *name;
+    AtlasTile top;
+    AtlasTile side;
+    AtlasTile bottom;
+    // Drawn in the opaque pass
+    bool opaque;
+    // Drawn in the transparent pass
+    bool transparent;
+    // Its texture scrolls over time
+    bool animated;
+    // The faces of other blocks show through it, but not those of other
+    // translucent blocks
+    bool translucent;
+    // Its sides are inset by one texel, and the top of the block below
+    // it shows around its base
+    bool inset;
+    // The player cannot move through it
+    bool collides;
+    // The player swims in it
+    bool liquid;
+};
+
+// Indexed by BlockType
+constexpr std::array<BlockProperties, BLOCK_TYPE_COUNT> BLOCKS {{
+    //                        top       side      bottom   opaque transp animat transl inset  collid liquid
+    {EMPTY,     "EMPTY",     {0, 0},   {0, 0},   {0, 0},   false, false, false, false, false, false, false},
+    {GRASS,     "GRASS",     {8, 13},  {3, 15},  {2, 15},  true,  false, false, false, false, true,  false},
+    {SNOWGRASS, "SNOWGRASS", {2, 11},  {4, 11},  {2, 15},  true,  false, false, false, false, true,  false},
+    {DIRT,      "DIRT",      {2, 15},  {2, 15},  {2, 15},  true,  false, false, false, false, true,  false},
+    {STONE,     "STONE",     {1, 15},  {1, 15},  {1, 15},  true,  false, false, false, false, true,  false},
+    {WATER,     "WATER",     {13, 3},  {13, 3},  {13, 3},  false, true,  true,  true,  false, false, true},
+    {SNOW,      "SNOW",      {2, 11},  {2, 11},  {2, 11},  true,  false, false, false, false, true,  false},
+    {LAVA,      "LAVA",      {13, 1},  {13, 1},  {13, 1},  true,  false, true,  false, false, false, true},
+    {BEDROCK,   "BEDROCK",   {1, 14},  {1, 14},  {1, 14},  true,  false, false, false, false, true,  false},
+    {ICE,       "ICE",       {3, 11},  {3, 11},  {3, 11},  false, true,  false, true,  false, true,  false},
+    {SAND,      "SAND",      {2, 14},  {2, 14},  {2, 14},  true,  false, false, false, false, true,  false},
+    {SANDSTONE, "SANDSTONE", {0, 4},   {0, 3},   {0, 2},   true,  false, false, false, false, true,  false},
+    {OBSIDIAN,  "OBSIDIAN",  {7, 4},   {7, 4},   {7, 4},   true,  false, false, false, false, true,  false},
+    {CACTUS,    "CACTUS",    {5, 11},  {6, 11},  {5, 11},  false, true,  false, false, true,  true,  false},
+    {COBBLE,    "COBBLE",    {0, 14},  {0, 14},  {0, 14},  true,  false, false, false, false, true,  false},
+    {WOOD,      "WOOD",      {5, 13},  {4, 13},  {5, 13},  true,  false, false, false, false, true,  false},
+    {LEAVES,    "LEAVES",    {5, 12},  {5, 12},  {5, 12},  true,  false, false, false, false, true,  false},
+    {SHIT,      "SHIT",      {14, 11}, {13, 11}, {2, 15},  true,  false, false, false, false, true,  false},
+}};
+
+// The blocks a biome's columns are made of
+struct BiomeProperties {
+    Biome biome;
+    // The surface block of a column
+    BlockType topBlock;
+    // The blocks between the surface and the stone below it
+    BlockType fillBlock;
+};
+
+// Indexed by Biome
+constexpr std::array<BiomeProperties, BIOME_COUNT> BIOMES {{
+    {ICE_SPIKES,      SNOW,      SNOW},
+    {SWAMP,           GRASS,     DIRT},
+    {ISLAND,          GRASS,     DIRT},
+    {TUNDRA,          SNOWGRASS, DIRT},
+    {GRASSLAND,       GRASS,     DIRT},
+    {VOLCANO,         STONE,     STONE},
+    {SHITLAND,        SHIT,      STONE},
+    {DESERT,          SAND,      SAND},
+    {DESERT_MOUNTAIN, SANDSTONE, SAND},
+}};
+
+constexpr const BlockProperties& blockProperties(BlockType t) {
+    return BLOCKS[t];
+}
+
+constexpr const BiomeProperties& biomeProperties(Biome b) {
+    return BIOMES[b];
+}
+
+namespace registry_detail {
+// Every entry sits at the index of the enum value it describes
+template<typename T, std::size_t N, typename F>
+constexpr bool inEnumOrder(const std::array<T, N> &table, F key) {
+    for (std::size_t i = 0; i < N; ++i) {
+        if (static_cast<std::size_t>(key(table[i])) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool drawnInOnePass(const BlockProperties &p) {
+    return p.type == EMPTY ? !p.opaque && !p.transparent : p.opaque != p.transparent;
+}
+
+constexpr bool everyBlockDrawnInOnePass() {
+    for (const BlockProperties &p : BLOCKS) {
+        if (!drawnInOnePass(p)) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+static_assert(registry_detail::inEnumOrder(BLOCKS, [](const BlockProperties &p) { return p.type; }),
+              "BLOCKS must list every BlockType in enum order");
+static_assert(registry_detail::inEnumOrder(BIOMES, [](const BiomeProperties &p) { return p.biome; }),
+              "BIOMES must list every Biome in enum order");
+static_assert(registry_detail::everyBlockDrawnInOnePass(),
+              "Every block but EMPTY must be exactly one of opaque and transparent");
@@ -1,23 +1,81 @@
 #include "chunk.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
-Chunk::Chunk(OpenGLContext *context) : Drawable(context),
+Chunk::Chunk(OpenGLContext *context, glm::ivec2 origin) : Drawable(context),
   m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
-  m_blocks(),
-  mp_context(context), m_VBOcreated(false), m_VBOcreatedO(false), m_VBOcreatedT(false),
-  mcr_VBOcreated(m_VBOcreated), m_blocksFilled(false), mcr_neighbors(m_neighbors)
+  m_sections(),
+  mp_context(context), m_origin(origin), m_VBOcreated(false), m_VBOcreatedO(false), m_VBOcreatedT(false),
+  m_state(ALLOCATED), m_generation(0), m_topBlock(), m_minY(256), m_maxY(-1), m_lastMeshVertices{{0, 0}},
+  mcr_origin(m_origin), mcr_VBOcreated(m_VBOcreated), mcr_neighbors(m_neighbors)
 {
-    std::fill_n(m_blocks.begin(), 65536, EMPTY);
+    m_topBlock.fill(-1);
 }
 
 void Chunk::destroy() {
     this->destroyVBOdata();
-    m_VBOcreated = false;
+    m_VBOcreated = m_VBOcreatedO = m_VBOcreatedT = false;
+}
+
+ChunkState Chunk::state() const {
+    return m_state.load(std::memory_order_acquire);
+}
+
+bool Chunk::blocksFilled() const {
+    return state() >= GENERATED;
+}
+
+bool Chunk::legalTransition(ChunkState from, ChunkState to) {
+    switch (to) {
+    case GENERATING:
+        return from == ALLOCATED;
+    case GENERATED:
+        return from == GENERATING;
+    case MESHING:
+        return from >= GENERATED;
+    case MESH_READY:
+        return from == MESHING;
+    case UPLOADED:
+        return from == MESH_READY;
+    case EVICTED:
+        return from >= GENERATED && from != EVICTED;
+    default:
+        return false;
+    }
+}
+
+// Release on success so that the blocks written before a chunk became
+// GENERATED are visible to any thread that sees it GENERATED
+bool Chunk::transition(ChunkState from, ChunkState to) {
+    if (!legalTransition(from, to)) {
+        throw std::logic_error("Illegal chunk state transition " + std::to_string(from) +
+                               " -> " + std::to_string(to));
+    }
+    return m_state.compare_exchange_strong(from, to, std::memory_order_acq_rel);
+}
+
+bool Chunk::advance(ChunkState to) {
+    ChunkState from = state();
+    while (legalTransition(from, to)) {
+        if (m_state.compare_exchange_weak(from, to, std::memory_order_acq_rel)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned Chunk::generation() const {
+    return m_generation.load(std::memory_order_acquire);
+}
+
+void Chunk::bumpGeneration() {
+    m_generation.fetch_add(1, std::memory_order_acq_rel);
 }
 
 // Does bounds checking with at()
 BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
-    return m_blocks.at(x + 16 * y + 16 * 256 * z);
+    return m_sections.at(y >> 4).getBlockAt(x, y & 15, z);
 }
 
 // Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
@@ -27,9 +85,174 @@ BlockType Chunk::getBlockAt(int x, int y, int z) const {
 
 }
 
-// Does bounds checking with at()
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    if (!blocksFilled()) {
+        writeBlockAt(x, y, z, t);
+        return;
+    }
+    QWriteLocker locker(&m_blocksLock);
+    writeBlockAt(x, y, z, t);
+}
+
+// Does bounds checking with at()
+void Chunk::writeBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
+    m_sections.at(y >> 4).setBlockAt(x, y & 15, z, t);
+
+    short &top = m_topBlock[x + 16 * z];
+    int iy = static_cast<int>(y);
+    if (t != EMPTY) {
+        if (iy > top) {
+            top = static_cast<short>(iy);
+        }
+        if (iy < m_minY.load(std::memory_order_relaxed)) {
+            m_minY.store(iy, std::memory_order_relaxed);
+        }
+        if (iy > m_maxY.load(std::memory_order_relaxed)) {
+            m_maxY.store(iy, std::memory_order_relaxed);
+        }
+        return;
+    }
+    if (iy != top) {
+        return;
+    }
+    // The column's top block was removed, so look for the next one down
+    int ny = iy - 1;
+    while (ny >= 0 && getBlockAt(x, static_cast<unsigned int>(ny), z) == EMPTY) {
+        --ny;
+    }
+    top = static_cast<short>(ny);
+    if (iy == m_maxY.load(std::memory_order_relaxed)) {
+        short maxTop = *std::max_element(m_topBlock.begin(), m_topBlock.end());
+        m_maxY.store(maxTop, std::memory_order_relaxed);
+    }
+}
+
+void Chunk::fillLayers(unsigned int yMin, unsigned int yMax, BlockType t) {
+    unsigned int y = yMin;
+    while (y <= yMax) {
+        // Whole section covered, so store it as one value
+        if ((y & 15) == 0 && y + 15 <= yMax) {
+            m_sections.at(y >> 4).fill(t);
+            y += 16;
+            continue;
+        }
+        for(unsigned int z = 0; z < 16; ++z) {
+            for(unsigned int x = 0; x < 16; ++x) {
+                writeBlockAt(x, y, z, t);
+            }
+        }
+        ++y;
+    }
+}
+
+void Chunk::compact() {
+    for (ChunkSection &s : m_sections) {
+        s.compact();
+    }
+}
+
+void Chunk::rebuildColumnData() {
+    m_topBlock.fill(-1);
+    int columnsLeft = 256;
+    for (int sy = 15; sy >= 0 && columnsLeft > 0; --sy) {
+        const ChunkSection &s = m_sections[sy];
+        if (s.isUniform() && s.uniformType() == EMPTY) {
+            continue;
+        }
+        for (unsigned int z = 0; z < 16; ++z) {
+            for (unsigned int x = 0; x < 16; ++x) {
+                short &top = m_topBlock[x + 16 * z];
+                if (top >= 0) {
+                    continue;
+                }
+                for (int yl = 15; yl >= 0; --yl) {
+                    if (s.getBlockAt(x, static_cast<unsigned int>(yl), z) != EMPTY) {
+                        top = static_cast<short>(sy * 16 + yl);
+                        --columnsLeft;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    m_maxY.store(*std::max_element(m_topBlock.begin(), m_topBlock.end()), std::memory_order_relaxed);
+
+    int minY = 256;
+    for (unsigned int sy = 0; sy < 16 && minY == 256; ++sy) {
+        const ChunkSection &s = m_sections[sy];
+        if (s.isUniform()) {
+            if (s.uniformType() != EMPTY) {
+                minY = sy * 16;
+            }
+            continue;
+        }
+        for (unsigned int yl = 0; yl < 16 && minY == 256; ++yl) {
+            for (unsigned int i = 0; i < 256; ++i) {
+                if (s.getBlockAt(i & 15, yl, i >> 4) != EMPTY) {
+                    minY = sy * 16 + yl;
+                    break;
+                }
+            }
+        }
+    }
+    m_minY.store(minY, std::memory_order_relaxed);
+}
+
+int Chunk::topBlockY(unsigned int x, unsigned int z) const {
+    // Still being written by the chunk's BlockTypeWorker
+    if (!blocksFilled()) {
+        return -1;
+    }
+    return m_topBlock.at(x + 16 * z);
+}
+
+const HeightTile& Chunk::ground() const {
+    return m_ground;
+}
+
+void Chunk::setGround(const HeightTile &tile) {
+    m_ground = tile;
+}
+
+int Chunk::minBlockY() const {
+    return m_minY.load(std::memory_order_relaxed);
+}
+
+int Chunk::maxBlockY() const {
+    return m_maxY.load(std::memory_order_relaxed);
+}
+
+unsigned Chunk::lastMeshVertices(bool transparent) const {
+    return m_lastMeshVertices[transparent].load(std::memory_order_relaxed);
+}
+
+void Chunk::setLastMeshVertices(unsigned opaque, unsigned transparent) {
+    m_lastMeshVertices[0].store(opaque, std::memory_order_relaxed);
+    m_lastMeshVertices[1].store(transparent, std::memory_order_relaxed);
+}
+
+const ChunkSection& Chunk::getSection(unsigned int sy) const {
+    return m_sections.at(sy);
+}
+
+QReadWriteLock& Chunk::blocksLock() const {
+    return m_blocksLock;
+}
+
+uint64_t Chunk::checksum() const {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    std::array<BlockType, 4096> blocks;
+    for (const ChunkSection &s : m_sections) {
+        s.decode(blocks);
+        for (BlockType t : blocks) {
+            hash = (hash ^ t) * 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+void Chunk::setSection(unsigned int sy, const std::array<BlockType, 4096> &blocks) {
+    m_sections.at(sy).pack(blocks);
 }
 
 
@@ -42,188 +265,85 @@ const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirectio
     {ZNEG, ZPOS}
 };
 
-void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
+void Chunk::linkNeighbor(Chunk *neighbor, Direction dir) {
     if(neighbor != nullptr) {
-        this->m_neighbors[dir] = neighbor.get();
+        this->m_neighbors[dir] = neighbor;
         neighbor->m_neighbors[oppositeDirection.at(dir)] = this;
     }
 }
 
-void Chunk::createVBOdataFace(glm::vec4 blockPos,  glm::vec4 v1, glm::vec4 v2, bool norNeg, glm::vec4 color, glm::vec4 uv, std::vector<GLuint> &ch_idx, std::vector<glm::vec4> &ch_vert_data, float size, float uvSize) {
-        blockPos.w = 1.f;
-        GLuint i = ch_vert_data.size()/4;
-        v1.w = 0;
-        v2.w = 0;
-        v1 = glm::normalize(v1);
-        v2 = glm::normalize(v2);
-        glm::vec4 nor = glm::vec4(glm::cross(glm::vec3(v1.x, v1.y, v1.z), glm::vec3(v2.x, v2.y, v2.z)), 1);
-        if (norNeg) {
-            nor = -nor;
-        }
+void Chunk::createVBOdataFace(glm::ivec3 blockPos, glm::ivec3 v1, glm::ivec3 v2, Direction nor, bool inset, glm::vec4 uv, std::vector<ChunkVertex> &ch_vert_data, glm::ivec2 size) {
+        glm::ivec2 tile = glm::ivec2(glm::round(glm::vec2(uv.x, uv.y) * 16.f));
+        bool animated = uv.z == 1;
+        bool transparent = uv.w == 1;
 
-        ch_vert_data.push_back(blockPos); //pos
-        ch_vert_data.push_back(nor); //nor
-        ch_vert_data.push_back(uv);
-        ch_vert_data.push_back(color);
-
-        ch_vert_data.push_back(blockPos + size*v1); //pos
-        ch_vert_data.push_back(nor); //nor
-        ch_vert_data.push_back(uv + glm::vec4(0, uvSize, 0, 0));
-        ch_vert_data.push_back(color);
-
-        ch_vert_data.push_back(blockPos + size*(v1+v2)); //pos
-        ch_vert_data.push_back(nor); //nor
-        ch_vert_data.push_back(uv + glm::vec4(uvSize, uvSize, 0, 0));
-        ch_vert_data.push_back(color);
-
-        ch_vert_data.push_back(blockPos + size*v2); //pos
-        ch_vert_data.push_back(nor); //nor
-        ch_vert_data.push_back(uv + glm::vec4(uvSize, 0, 0, 0));
-        ch_vert_data.push_back(color);
-
-        ch_idx.push_back(i);
-        ch_idx.push_back(i+1);
-        ch_idx.push_back(i+3);
-        ch_idx.push_back(i+2);
-        ch_idx.push_back(i+3);
-        ch_idx.push_back(i+1);
-}
-
-void Chunk::createVBOdataCube(BlockType t, BlockType ip, BlockType in, BlockType jp, BlockType jn, BlockType kp, BlockType kn,
-                       glm::vec4 blockPos, std::vector<GLuint> &ch_idx, std::vector<glm::vec4> &ch_vert_data) {
-                    glm::vec4 uvTop = glm::vec4(0, 0, 0, 0); //z = 1 if animated w = 1 if transparent
-                    glm::vec4 uvBot = glm::vec4(0, 0, 0, 0);
-                    glm::vec4 uv = glm::vec4(0, 0, 0, 0);
-                    glm::vec4 color = glm::vec4(0, 0, 0, 0);
-                    float idx = 0.0625f;
-                    switch(t) {
-                        case GRASS:
-                            uvTop = glm::vec4(0.5, 0.8125, 0, 0);
-                            uvBot = glm::vec4(0.125, 0.9375, 0, 0);
-                            uv = glm::vec4(0.1825, 0.9375, 0, 0);
-                            break;
-                        case DIRT:
-                            uvTop = glm::vec4(0.125, 0.9375, 0, 0);
-                            uvBot = glm::vec4(0.125, 0.9375, 0, 0);
-                            uv = glm::vec4(0.125, 0.9375, 0, 0);
-                            break;
-                        case STONE:
-                            uvTop = glm::vec4(0.0625, 0.9375, 0, 0);
-                            uvBot = glm::vec4(0.0625, 0.9375, 0, 0);
-                            uv = glm::vec4(0.0625, 0.9375, 0, 0);
-                            break;
-                        case WATER:
-                            uvTop = glm::vec4(0.8125, 0.1875, 1, 1);
-                            uvBot = glm::vec4(0.8125, 0.1875, 1, 1);
-                            uv = glm::vec4(0.8125, 0.1875, 1, 1);
-                            break;
-                        case LAVA:
-                            uvTop = glm::vec4(0.8125, 0.0625, 1, 0);
-                            uvBot = glm::vec4(0.8125, 0.0625, 1, 0);
-                            uv = glm::vec4(0.8125, 0.0625, 1, 0);
-                            break;
-                        case SNOW:
-                            uvTop = glm::vec4(0.125, 0.6875, 0, 0);
-                            uvBot = glm::vec4(0.125, 0.6875, 0, 0);
-                            uv = glm::vec4(0.125, 0.6875, 0, 0);
-                            break;
-                        case ICE:
-                            uv = glm::vec4(3*idx, 11*idx, 0, 1);
-                            uvTop = uv;
-                            uvBot = uv;
-                            break;
-                        case COBBLE:
-                            uv = glm::vec4(0, 14*idx, 0, 0);
-                            uvTop = uv;
-                            uvBot = uv;
-                            break;
-                        case SANDSTONE:
-                            uv = glm::vec4(0, 3*idx, 0, 0);
-                            uvTop = glm::vec4(0, 4*idx, 0, 0);
-                            uvBot = glm::vec4(0, 2*idx, 0, 0);
-                            break;
-                        case SAND:
-                            uv = glm::vec4(2*idx, 14*idx, 0, 0);
-                            uvTop = uv;
-                            uvBot = uv;
-                            break;
-                        case OBSIDIAN:
-                            uv = glm::vec4(7*idx, 4*idx, 0, 0);
-                            uvTop = uv;
-                            uvBot = uv;
-                            break;
-                        case BEDROCK:
-                            uv = glm::vec4(1*idx, 14*idx, 0, 0);
-                            uvTop = uv;
-                            uvBot = uv;
-                            break;
-                        case CACTUS:
-                            uv = glm::vec4(6*idx, 11*idx, 0, 1);
-                            uvTop = glm::vec4(5*idx, 11*idx, 0, 1);
-                            uvBot = uvTop;
-                            break;
-                        case SNOWGRASS:
-                            uv = glm::vec4(4*idx, 11*idx, 0, 0);
-                            uvTop = glm::vec4(2*idx, 11*idx, 0, 0);
-                            uvBot = glm::vec4(2*idx, 15*idx, 0, 0);
-                            break;
-                        case WOOD:
-                            uv = glm::vec4(4*idx, 13*idx, 0, 0);
-                            uvTop = glm::vec4(5*idx, 13*idx, 0, 0);
-                            uvBot = glm::vec4(5*idx, 13*idx, 0, 0);
-                            break;
-                        case LEAVES:
-                            uv = glm::vec4(5*idx, 12*idx, 0, 0);
-                            uvTop = uv;
-                            uvBot = uv;
-                            break;
-                        case SHIT:
-                            uv = glm::vec4(13*idx, 11*idx, 0, 0);
-                            uvTop = glm::vec4(14*idx, 11*idx, 0, 0);
-                            uvBot = glm::vec4(2*idx, 15*idx, 0, 0);
-                            break;
-                        case EMPTY:
-                            break;
-                        default:
-                             // Other block types are not yet handled, so we default to debug purple
-                             break;
-                    }
-                    float eOff = 0;
-                    if (t == CACTUS) {
-                        eOff = 1/16.f;
-                    }
-                    if (ip == EMPTY || ((ip == WATER || ip == ICE) && t != WATER && t != ICE)) { //right face
-                        createVBOdataFace(blockPos + glm::vec4(1-eOff, 0, 0, 0), glm::vec4(0.f, 1.f, 0.f, 0.f), glm::vec4(0.f, 0.f, 1.f, 0.f), false, color, uv, ch_idx, ch_vert_data);
+        ch_vert_data.push_back(ChunkVertex(blockPos, nor, inset, tile, glm::ivec2(0, 0), animated, transparent));
+        ch_vert_data.push_back(ChunkVertex(blockPos + size.x*v1, nor, inset, tile, glm::ivec2(0, size.x), animated, transparent));
+        ch_vert_data.push_back(ChunkVertex(blockPos + size.x*v1 + size.y*v2, nor, inset, tile, glm::ivec2(size.y, size.x), animated, transparent));
+        ch_vert_data.push_back(ChunkVertex(blockPos + size.y*v2, nor, inset, tile, glm::ivec2(size.y, 0), animated, transparent));
+}
+
+void Chunk::blockUVs(BlockType t, glm::vec4 &uvTop, glm::vec4 &uvBot, glm::vec4 &uv) {
+    const BlockProperties &p = blockProperties(t);
+    //z = 1 if animated w = 1 if transparent
+    float animated = p.animated ? 1.f : 0.f;
+    float transparent = p.transparent ? 1.f : 0.f;
+    auto tileUV = [&](AtlasTile tile) {
+        return glm::vec4(tile.x / 16.f, tile.y / 16.f, animated, transparent);
+    };
+    uvTop = tileUV(p.top);
+    uvBot = tileUV(p.bottom);
+    uv = tileUV(p.side);
+}
+
+bool Chunk::faceVisible(BlockType t, BlockType neighbor, Direction dir) {
+    if (neighbor == EMPTY) {
+        return true;
+    }
+    const BlockProperties &n = blockProperties(neighbor);
+    // An inset block does not cover the top of the block below it
+    if (dir == YPOS && n.inset) {
+        return true;
+    }
+    return n.translucent && !blockProperties(t).translucent;
+}
+
+void Chunk::createVBOdataCube(BlockType t, unsigned int faces, glm::ivec3 blockPos,
+                              std::vector<ChunkVertex> &ch_vert_data) {
+                    glm::vec4 uvTop, uvBot, uv;
+                    blockUVs(t, uvTop, uvBot, uv);
+                    bool inset = blockProperties(t).inset;
+                    if (faces & (1 << XPOS)) { //right face
+                        createVBOdataFace(blockPos + glm::ivec3(1, 0, 0), glm::ivec3(0, 1, 0), glm::ivec3(0, 0, 1), XPOS, inset, uv, ch_vert_data);
                     }
-                    if (in == EMPTY || ((in == WATER || in == ICE) && t != WATER && t != ICE)) { //left face
-                        createVBOdataFace(blockPos + glm::vec4(eOff, 0, 0, 0), glm::vec4(0.f, 1.f, 0.f, 0.f), glm::vec4(0.f, 0.f, 1.f, 0.f), true, color, uv, ch_idx, ch_vert_data);
+                    if (faces & (1 << XNEG)) { //left face
+                        createVBOdataFace(blockPos, glm::ivec3(0, 1, 0), glm::ivec3(0, 0, 1), XNEG, inset, uv, ch_vert_data);
                     }
-                    if (jp == EMPTY || jp == CACTUS || ((jp == WATER|| jp == ICE) && t != WATER && t != ICE)) { //top face
-                        createVBOdataFace(blockPos + glm::vec4(0, 1, 0, 0), glm::vec4(0.f, 0.f, 1.f, 0.f), glm::vec4(1.f, 0.f, 0.f, 0.f), false, color, uvTop, ch_idx, ch_vert_data);
+                    if (faces & (1 << YPOS)) { //top face
+                        createVBOdataFace(blockPos + glm::ivec3(0, 1, 0), glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 0), YPOS, false, uvTop, ch_vert_data);
 
                     }
-                    if (jn == EMPTY || ((jn == WATER || jn == ICE) && (t != WATER && t != ICE))) { //bottom face
-                        createVBOdataFace(blockPos, glm::vec4(0.f, 0.f, 1.f, 0.f), glm::vec4(1.f, 0.f, 0.f, 0.f), true, color, uvBot, ch_idx, ch_vert_data);
+                    if (faces & (1 << YNEG)) { //bottom face
+                        createVBOdataFace(blockPos, glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 0), YNEG, false, uvBot, ch_vert_data);
                     }
-                    if (kp == EMPTY || ((kp == WATER || kp == ICE)  && t != WATER && t != ICE)) { //front face
-                        createVBOdataFace(blockPos + glm::vec4(0, 0, 1 - eOff, 0), glm::vec4(0.f, 1.f, 0.f, 0.f), glm::vec4(1.f, 0.f, 0.f, 0.f), true, color, uv, ch_idx, ch_vert_data);
+                    if (faces & (1 << ZPOS)) { //front face
+                        createVBOdataFace(blockPos + glm::ivec3(0, 0, 1), glm::ivec3(0, 1, 0), glm::ivec3(1, 0, 0), ZPOS, inset, uv, ch_vert_data);
                     }
-                    if (kn == EMPTY || ((kn == WATER || kn == ICE) && t != WATER && t != ICE)) { //back face
-                        createVBOdataFace(blockPos + glm::vec4(0, 0, eOff, 0), glm::vec4(0.f, 1.f, 0.f, 0.f), glm::vec4(1.f, 0.f, 0.f, 0.f), false, color, uv, ch_idx, ch_vert_data);
+                    if (faces & (1 << ZNEG)) { //back face
+                        createVBOdataFace(blockPos, glm::ivec3(0, 1, 0), glm::ivec3(1, 0, 0), ZNEG, inset, uv, ch_vert_data);
                     }
 }
 
-void Chunk::createVBOdata(std::vector<GLuint> &opaqueIdx, std::vector<glm::vec4> &opaqueData) {
-    m_count = opaqueIdx.size();
-
-    generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_count * sizeof(GLuint),
-                             opaqueIdx.data(), GL_STATIC_DRAW);
+void Chunk::createVBOdata(std::vector<ChunkVertex> &opaqueData) {
+    // Two triangles per four-vertex quad
+    m_count = opaqueData.size() / 4 * 6;
 
-    generateInter();
+    // Remeshes reuse the buffer, so the old mesh stays valid until now
+    if (!m_interGenerated) {
+        generateInter();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufInter);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, opaqueData.size() * sizeof(glm::vec4),
+    mp_context->glBufferData(GL_ARRAY_BUFFER, opaqueData.size() * sizeof(ChunkVertex),
                              opaqueData.data(), GL_STATIC_DRAW);
 
     m_VBOcreatedO = true;
@@ -233,22 +353,18 @@ void Chunk::createVBOdata(std::vector<GLuint> &opaqueIdx, std::vector<glm::vec4>
 //    m_VBOcreated = true;
 }
 
-void Chunk::createVBOdataTransparent(std::vector<GLuint> &transparentIdx, std::vector<glm::vec4> &transparentData) {
-
-    m_countT = transparentIdx.size();
-
-    generateIdxT();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxT);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_countT * sizeof(GLuint),
-                             transparentIdx.data(), GL_STATIC_DRAW);
+void Chunk::createVBOdataTransparent(std::vector<ChunkVertex> &transparentData) {
+    m_countT = transparentData.size() / 4 * 6;
 
-    generateInterT();
+    if (!m_interTGenerated) {
+        generateInterT();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufInterT);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, transparentData.size() * sizeof(glm::vec4),
+    mp_context->glBufferData(GL_ARRAY_BUFFER, transparentData.size() * sizeof(ChunkVertex),
                              transparentData.data(), GL_STATIC_DRAW);
 
     m_VBOcreatedT = true;
-    if (m_VBOcreatedT) {
+    if (m_VBOcreatedO) {
         m_VBOcreated = true;
     }
 }
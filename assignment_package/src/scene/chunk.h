@@ -3,7 +3,13 @@
 #include "glm_includes.h"
 #include "drawable.h"
 #include "terrain.h"
+#include "chunksection.h"
+#include "blockregistry.h"
+#include "heighttile.h"
+#include "chunkvertex.h"
 #include <array>
+#include <atomic>
+#include <QReadWriteLock>
 #include <unordered_map>
 #include <cstddef>
 
@@ -11,22 +17,28 @@ struct ChunkVBOData;
 
 //using namespace std;
 
-// C++ 11 allows us to define the size of an enum. This lets us use only one byte
-// of memory to store our different block types. By default, the size of a C++ enum
-// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
-// block types, but in the scope of this project we'll never get anywhere near that many.
-enum BlockType : unsigned char
-{
-    EMPTY, GRASS, SNOWGRASS, DIRT, STONE, WATER, SNOW, LAVA, BEDROCK, ICE,
-    SAND, SANDSTONE, OBSIDIAN, CACTUS, COBBLE, WOOD, LEAVES, SHIT
-};
-
 // The six cardinal directions in 3D space
 enum Direction : unsigned char
 {
     XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
 };
 
+// Where a Chunk is in its life. A chunk moves forward through these
+// states; only meshing may restart from a later state, when the chunk is
+// remeshed or comes back into view after being evicted.
+//   ALLOCATED  -> GENERATING  BlockTypeWorker started filling its blocks
+//   GENERATING -> GENERATED   its blocks are final and may be read
+//   GENERATED, MESH_READY, UPLOADED, EVICTED -> MESHING
+//                             a VBOWorker started meshing it
+//   MESHING    -> MESH_READY  a finished mesh is waiting to be uploaded
+//   MESH_READY -> UPLOADED    the mesh is on the GPU
+//   GENERATED .. UPLOADED -> EVICTED
+//                             the player left and its buffers were freed
+enum ChunkState : unsigned char
+{
+    ALLOCATED, GENERATING, GENERATED, MESHING, MESH_READY, UPLOADED, EVICTED
+};
+
 // Lets us use any enum class as the key of a
 // std::unordered_map
 struct EnumHash {
@@ -48,32 +60,130 @@ class Chunk : public Drawable {
 private:
     // All of the blocks contained within this Chunk
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
-    std::array<BlockType, 65536> m_blocks;
+    // Stored as sixteen 16 x 16 x 16 sections stacked along Y,
+    // so that all-air and all-stone sections cost a single byte
+    std::array<ChunkSection, 16> m_sections;
+    // Guards m_sections and m_topBlock once the chunk is generated: mesh
+    // jobs hold it for reading while they copy the blocks, and setBlockAt
+    // holds it for writing. Before that only the chunk's BlockTypeWorker
+    // touches its blocks, so generation runs without it.
+    mutable QReadWriteLock m_blocksLock;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
     // These allow us to properly determine
     OpenGLContext *mp_context;
+    // World-space x and z of this Chunk's lower-left corner
+    glm::ivec2 m_origin;
     boolean m_VBOcreated; //true when both opaque and transparent
     boolean m_VBOcreatedO; //opaque
     boolean m_VBOcreatedT; //transparent
+    // Read and written from any thread
+    std::atomic<ChunkState> m_state;
+    // Bumped whenever a mesh made before would be out of date, so that
+    // results of older mesh jobs can be told apart and dropped
+    std::atomic<unsigned> m_generation;
+    // Y of the highest non-EMPTY block of each column, indexed x + 16 * z,
+    // or -1 if the column is all air. Only read from the main thread, and
+    // only once the chunk is generated: topBlockY checks blocksFilled,
+    // whose acquire load orders the read after generation's writes.
+    std::array<short, 256> m_topBlock;
+    // Every non-EMPTY block lies within m_minY <= y <= m_maxY, and
+    // m_minY > m_maxY if there are none. Exact after rebuildColumnData();
+    // m_minY may stay lower than needed after blocks are removed.
+    // Read by meshers on other threads.
+    std::atomic<int> m_minY;
+    std::atomic<int> m_maxY;
+    // The ground height and biome of each column the chunk was generated
+    // from, kept so that later passes need not evaluate the noise again
+    HeightTile m_ground;
+    // Vertex counts of the last opaque and transparent meshes uploaded,
+    // to size the buffers of the next mesh
+    std::array<std::atomic<unsigned>, 2> m_lastMeshVertices;
+
+    // setBlockAt without the lock
+    void writeBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
 
 public:
-    Chunk(OpenGLContext *context);
+    Chunk(OpenGLContext *context, glm::ivec2 origin);
     virtual ~Chunk() {};
+    const glm::ivec2& mcr_origin;
     // A readonly reference to VBO status
     const boolean& mcr_VBOcreated;
-    boolean m_blocksFilled;
+    ChunkState state() const;
+    // Has the chunk's generation finished, so that its blocks may be read
+    // from other threads?
+    bool blocksFilled() const;
+    // Moves the chunk from state `from` to `to`. Returns false, and changes
+    // nothing, if the chunk is not in state `from`.
+    // Throws std::logic_error if `to` can never follow `from`.
+    bool transition(ChunkState from, ChunkState to);
+    // Moves the chunk to `to` from whatever state it is in, if `to` may
+    // follow that state. Returns whether it did.
+    bool advance(ChunkState to);
+    unsigned generation() const;
+    // Marks every mesh made so far as out of date
+    void bumpGeneration();
+    static bool legalTransition(ChunkState from, ChunkState to);
     const std::unordered_map<Direction, Chunk*, EnumHash>& mcr_neighbors;
     void createVBOdata() override {};
-    void createVBOdata(std::vector<GLuint> &, std::vector<glm::vec4> &);
-    void createVBOdataTransparent(std::vector<GLuint> &, std::vector<glm::vec4> &);
-    void createVBOdataCube(BlockType, BlockType, BlockType, BlockType, BlockType, BlockType, BlockType,
-                           glm::vec4, std::vector<GLuint> &, std::vector<glm::vec4> &);
-    void createVBOdataFace(glm::vec4 blockPos,  glm::vec4 v1, glm::vec4 v2, bool negNor, glm::vec4 color, glm::vec4 uv, std::vector<GLuint> &ch_idx, std::vector<glm::vec4> &ch_vert_data, float size = 1, float uvSize = 0.0625f);
+    // Upload a mesh of quads. Chunks have no index buffers of their own;
+    // they are drawn with the quad index buffer shared by the Terrain.
+    void createVBOdata(std::vector<ChunkVertex> &);
+    void createVBOdataTransparent(std::vector<ChunkVertex> &);
+    // Appends the faces of block t at blockPos whose bits are set in faces,
+    // bit 1 << d for each Direction d
+    void createVBOdataCube(BlockType t, unsigned int faces, glm::ivec3 blockPos,
+                           std::vector<ChunkVertex> &);
+    // Appends one quad facing nor that starts at blockPos and spans size.x blocks
+    // along v1 and size.y blocks along v2. The texture tile at uv is repeated
+    // once per block covered by the quad.
+    void createVBOdataFace(glm::ivec3 blockPos, glm::ivec3 v1, glm::ivec3 v2, Direction nor, bool inset, glm::vec4 uv, std::vector<ChunkVertex> &ch_vert_data, glm::ivec2 size = glm::ivec2(1));
+    // Looks up the atlas UVs of the top, bottom and side faces of t.
+    // z = 1 if the texture is animated, w = 1 if it is transparent.
+    static void blockUVs(BlockType t, glm::vec4 &uvTop, glm::vec4 &uvBot, glm::vec4 &uv);
+    // Should the face of block t pointing in direction dir be drawn,
+    // given that the block on the other side of that face is neighbor?
+    static bool faceVisible(BlockType t, BlockType neighbor, Direction dir);
     void destroy();
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
+    // Raw write used during generation. Edits to a live chunk should go
+    // through Terrain::setBlockAt, which also schedules the remesh.
+    // Takes the blocks lock once the chunk is generated.
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
-    void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // Sets every block with yMin <= y <= yMax to t, collapsing
+    // fully covered sections into a single uniform value
+    void fillLayers(unsigned int yMin, unsigned int yMax, BlockType t);
+    // Replaces every block of the section holding layer sy * 16, indexed
+    // x + 16 * y + 256 * z. Like fillLayers, it bypasses setBlockAt.
+    void setSection(unsigned int sy, const std::array<BlockType, 4096> &blocks);
+    // Repacks every section with the narrowest palette that fits it.
+    // Called once a chunk's generation is finished.
+    void compact();
+    // Recomputes the column heights and Y range from scratch, for after
+    // writes that bypass setBlockAt such as fillLayers.
+    // Called once a chunk's generation is finished.
+    void rebuildColumnData();
+    // Y of the highest non-EMPTY block in column (x, z), or -1. Until the
+    // chunk is generated every column reads as air, as only its
+    // BlockTypeWorker may touch its blocks before then.
+    int topBlockY(unsigned int x, unsigned int z) const;
+    // Bounds on the Y of every non-EMPTY block; minBlockY() > maxBlockY()
+    // if the chunk is all air
+    int minBlockY() const;
+    int maxBlockY() const;
+    // Set by generation, and readable once blocksFilled()
+    const HeightTile& ground() const;
+    void setGround(const HeightTile &);
+    unsigned lastMeshVertices(bool transparent) const;
+    void setLastMeshVertices(unsigned opaque, unsigned transparent);
+    // Readonly access to the 16 x 16 x 16 section holding layer sy * 16.
+    // Other threads must hold blocksLock() for reading while they use it.
+    const ChunkSection& getSection(unsigned int sy) const;
+    QReadWriteLock& blocksLock() const;
+    // FNV-1a hash of every block, bottom section first, the same however
+    // the sections are packed
+    uint64_t checksum() const;
+    void linkNeighbor(Chunk* neighbor, Direction dir);
 };
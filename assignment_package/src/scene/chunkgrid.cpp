@@ -0,0 +1,43 @@
+#include "chunkgrid.h"
+#include "chunkmap.h"
+#include "terrain.h"
+
+ChunkGrid::ChunkGrid()
+    : m_slots(), m_center(0, 0)
+{
+    int lo = -SIZE / 2;
+    for (int sz = 0; sz < SIZE; sz++) {
+        for (int sx = 0; sx < SIZE; sx++) {
+            Slot &s = m_slots[sx + sz * SIZE];
+            s.pos = glm::ivec2(lo + ((sx - lo) & (SIZE - 1)), lo + ((sz - lo) & (SIZE - 1)));
+            s.chunk = nullptr;
+        }
+    }
+}
+
+void ChunkGrid::set(int cx, int cz, Chunk *chunk) {
+    if (contains(cx, cz)) {
+        m_slots[indexOf(cx, cz)].chunk = chunk;
+    }
+}
+
+void ChunkGrid::recenter(int cx, int cz, const ChunkMap &chunks) {
+    if (m_center == glm::ivec2(cx, cz)) {
+        return;
+    }
+    m_center = glm::ivec2(cx, cz);
+    // Each slot stands for the one chunk of the window [center - SIZE / 2,
+    // center + SIZE / 2) that maps to it; only the ones that changed are
+    // looked up again
+    glm::ivec2 lo = m_center - glm::ivec2(SIZE / 2);
+    for (int sz = 0; sz < SIZE; sz++) {
+        for (int sx = 0; sx < SIZE; sx++) {
+            glm::ivec2 pos(lo.x + ((sx - lo.x) & (SIZE - 1)), lo.y + ((sz - lo.y) & (SIZE - 1)));
+            Slot &s = m_slots[sx + sz * SIZE];
+            if (s.pos != pos) {
+                s.pos = pos;
+                s.chunk = chunks.find(Terrain::toKey(pos.x * 16, pos.y * 16));
+            }
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+
+class Chunk;
+class ChunkMap;
+
+// A SIZE x SIZE window of chunk slots centred on the player's chunk.
+// The chunk at chunk coordinates (cx, cz) lives in slot
+// (cx mod SIZE, cz mod SIZE), so a lookup is a mask and a compare with
+// no hashing. When the window moves, the slots on the edge it left wrap
+// around to the edge it moved towards and are refilled from the ChunkMap,
+// which stays the owner of every chunk.
+// Only used from the main thread.
+class ChunkGrid {
+public:
+    // Wide enough for the 5 x 5 zones around the player, with room to spare
+    static const int SIZE = 32;
+
+private:
+    struct Slot {
+        // Chunk coordinates (world-space corner / 16) this slot stands for
+        glm::ivec2 pos;
+        // nullptr if that chunk has not been instantiated
+        Chunk *chunk;
+    };
+    std::array<Slot, SIZE * SIZE> m_slots;
+    glm::ivec2 m_center;
+
+    static int indexOf(int cx, int cz);
+
+public:
+    ChunkGrid();
+
+    // Is chunk (cx, cz) inside the window? If so, at() is authoritative.
+    bool contains(int cx, int cz) const;
+    Chunk* at(int cx, int cz) const;
+    // Records a newly instantiated chunk if it falls inside the window
+    void set(int cx, int cz, Chunk *chunk);
+    // Centres the window on chunk (cx, cz)
+    void recenter(int cx, int cz, const ChunkMap &chunks);
+    // Calls f on every chunk in the window, in slot order
+    template<typename F>
+    void forEach(F f) const;
+};
+
+inline int ChunkGrid::indexOf(int cx, int cz) {
+    return (cx & (SIZE - 1)) + (cz & (SIZE - 1)) * SIZE;
+}
+
+inline bool ChunkGrid::contains(int cx, int cz) const {
+    return m_slots[indexOf(cx, cz)].pos == glm::ivec2(cx, cz);
+}
+
+inline Chunk* ChunkGrid::at(int cx, int cz) const {
+    return m_slots[indexOf(cx, cz)].chunk;
+}
+
+template<typename F>
+void ChunkGrid::forEach(F f) const {
+    for (const Slot &s : m_slots) {
+        if (s.chunk != nullptr) {
+            f(s.chunk);
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#include "chunkmap.h"
+#include "chunk.h"
+
+ChunkMap::ChunkMap()
+    : m_shards()
+{}
+
+ChunkMap::~ChunkMap() {}
+
+// Chunk corners are multiples of 16, so the key is mixed before picking a
+// shard to keep neighbouring chunks from piling into the same one
+int ChunkMap::shardOf(int64_t key) {
+    uint64_t h = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+    return static_cast<int>(h >> 60) % SHARD_COUNT;
+}
+
+Chunk* ChunkMap::find(int64_t key) const {
+    const Shard &s = m_shards[shardOf(key)];
+    QReadLocker locker(&s.lock);
+    auto it = s.chunks.find(key);
+    return it == s.chunks.end() ? nullptr : it->second.get();
+}
+
+bool ChunkMap::contains(int64_t key) const {
+    return find(key) != nullptr;
+}
+
+Chunk* ChunkMap::insert(int64_t key, uPtr<Chunk> chunk) {
+    Shard &s = m_shards[shardOf(key)];
+    Chunk *c = chunk.get();
+    QWriteLocker locker(&s.lock);
+    s.chunks[key] = std::move(chunk);
+    return c;
+}
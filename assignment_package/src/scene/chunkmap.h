@@ -0,0 +1,51 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include <QReadWriteLock>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+class Chunk;
+
+// Owns every Chunk of the Terrain, keyed by Terrain::toKey of the chunk's
+// lower-left corner. Chunks are looked up from worker threads while the
+// main thread adds new ones, so the map is split into shards that each
+// sit behind their own read-write lock. Lookups never block each other,
+// and only wait on an insertion into the same shard.
+// Chunks are never removed, so a Chunk* returned by find stays valid for
+// as long as the map exists.
+class ChunkMap {
+private:
+    static const int SHARD_COUNT = 16;
+
+    struct Shard {
+        mutable QReadWriteLock lock;
+        std::unordered_map<int64_t, uPtr<Chunk>> chunks;
+    };
+    std::array<Shard, SHARD_COUNT> m_shards;
+
+    static int shardOf(int64_t key);
+
+public:
+    ChunkMap();
+    ~ChunkMap();
+
+    // The chunk stored at key, or nullptr if there is none
+    Chunk* find(int64_t key) const;
+    bool contains(int64_t key) const;
+    // Stores chunk at key, which must not hold a chunk yet, and returns it
+    Chunk* insert(int64_t key, uPtr<Chunk> chunk);
+    // Calls f on every chunk. f must not insert into the map.
+    template<typename F>
+    void forEach(F f) const;
+};
+
+template<typename F>
+void ChunkMap::forEach(F f) const {
+    for (const Shard &s : m_shards) {
+        QReadLocker locker(&s.lock);
+        for (const auto &kv : s.chunks) {
+            f(kv.second.get());
+        }
+    }
+}
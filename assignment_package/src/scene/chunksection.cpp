@@ -0,0 +1,176 @@
+#include "chunksection.h"
+#include "chunk.h"
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+ChunkSection::PackedIndices::PackedIndices(unsigned int bits)
+    : bits(bits), words(4096 * bits / 64, 0)
+{}
+
+// bits is always a power of two, so an index never straddles two words
+unsigned int ChunkSection::PackedIndices::get(unsigned int idx) const {
+    unsigned int bit = idx * bits;
+    return (words[bit >> 6] >> (bit & 63)) & ((1u << bits) - 1);
+}
+
+void ChunkSection::PackedIndices::set(unsigned int idx, unsigned int v) {
+    unsigned int bit = idx * bits;
+    uint64_t mask = static_cast<uint64_t>((1u << bits) - 1) << (bit & 63);
+    uint64_t &w = words[bit >> 6];
+    w = (w & ~mask) | ((static_cast<uint64_t>(v) << (bit & 63)) & mask);
+}
+
+ChunkSection::ChunkSection()
+    : m_palette(), m_paletteSize(1), m_indices(nullptr)
+{
+    m_palette[0] = EMPTY;
+}
+
+// Does bounds checking on the flattened index
+BlockType ChunkSection::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
+    unsigned int idx = x + 16 * y + 256 * z;
+    if (idx >= 4096) {
+        throw std::out_of_range("Section index " + std::to_string(idx) + " out of range!");
+    }
+    const PackedIndices *indices = m_indices.get();
+    if (indices == nullptr) {
+        return m_palette[0];
+    }
+    unsigned int v = indices->get(idx);
+    return indices->bits == 8 ? static_cast<BlockType>(v) : m_palette[v];
+}
+
+// Does bounds checking on the flattened index
+void ChunkSection::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
+    unsigned int idx = x + 16 * y + 256 * z;
+    if (idx >= 4096) {
+        throw std::out_of_range("Section index " + std::to_string(idx) + " out of range!");
+    }
+    if (m_indices == nullptr) {
+        if (t == m_palette[0]) {
+            return;
+        }
+        m_indices = mkU<PackedIndices>(1);
+    }
+    if (m_indices->bits == 8) {
+        m_indices->set(idx, t);
+        return;
+    }
+    unsigned int v = paletteIndexOf(t);
+    if (v == m_paletteSize) {
+        if (m_paletteSize == (1u << m_indices->bits)) {
+            widen();
+            setBlockAt(x, y, z, t);
+            return;
+        }
+        m_palette[m_paletteSize] = t;
+        ++m_paletteSize;
+    }
+    m_indices->set(idx, v);
+}
+
+unsigned int ChunkSection::paletteIndexOf(BlockType t) const {
+    for (unsigned int i = 0; i < m_paletteSize; ++i) {
+        if (m_palette[i] == t) {
+            return i;
+        }
+    }
+    return m_paletteSize;
+}
+
+void ChunkSection::widen() {
+    unsigned int bits = m_indices->bits * 2;
+    uPtr<PackedIndices> wider = mkU<PackedIndices>(bits);
+    for (unsigned int idx = 0; idx < 4096; ++idx) {
+        unsigned int v = m_indices->get(idx);
+        wider->set(idx, bits == 8 ? static_cast<unsigned int>(m_palette[v]) : v);
+    }
+    m_indices = std::move(wider);
+}
+
+void ChunkSection::pack(const std::array<BlockType, 4096> &blocks) {
+    std::array<bool, 256> used{};
+    // The palette index of each type used, while there are at most 16
+    std::array<unsigned char, 256> paletteIndex{};
+    std::array<BlockType, 16> palette{};
+    unsigned int paletteSize = 0;
+    for (BlockType t : blocks) {
+        if (!used[t]) {
+            used[t] = true;
+            if (paletteSize < 16) {
+                palette[paletteSize] = t;
+                paletteIndex[t] = static_cast<unsigned char>(paletteSize);
+            }
+            ++paletteSize;
+        }
+    }
+    if (paletteSize == 1) {
+        fill(blocks[0]);
+        return;
+    }
+    unsigned int bits = paletteSize <= 2 ? 1 : paletteSize <= 4 ? 2 : paletteSize <= 16 ? 4 : 8;
+    uPtr<PackedIndices> packed = mkU<PackedIndices>(bits);
+    // Like decode(), a whole 64-bit word at a time
+    unsigned int perWord = 64 / bits;
+    unsigned int idx = 0;
+    for (uint64_t &w : packed->words) {
+        uint64_t word = 0;
+        for (unsigned int i = 0; i < perWord; ++i, ++idx) {
+            uint64_t v = bits == 8 ? static_cast<uint64_t>(blocks[idx])
+                                   : static_cast<uint64_t>(paletteIndex[blocks[idx]]);
+            word |= v << (i * bits);
+        }
+        w = word;
+    }
+    m_palette = palette;
+    m_paletteSize = std::min(paletteSize, 16u);
+    m_indices = std::move(packed);
+}
+
+void ChunkSection::fill(BlockType t) {
+    m_indices.reset();
+    m_palette[0] = t;
+    m_paletteSize = 1;
+}
+
+void ChunkSection::compact() {
+    if (m_indices == nullptr) {
+        return;
+    }
+    std::array<BlockType, 4096> blocks;
+    decode(blocks);
+    pack(blocks);
+}
+
+void ChunkSection::decode(std::array<BlockType, 4096> &out) const {
+    const PackedIndices *indices = m_indices.get();
+    if (indices == nullptr) {
+        out.fill(m_palette[0]);
+        return;
+    }
+    // Unpack one 64-bit word at a time rather than re-deriving
+    // the word and shift for every block
+    unsigned int bits = indices->bits;
+    unsigned int perWord = 64 / bits;
+    uint64_t mask = (1u << bits) - 1;
+    unsigned int idx = 0;
+    for (uint64_t w : indices->words) {
+        for (unsigned int i = 0; i < perWord; ++i, w >>= bits) {
+            unsigned int v = static_cast<unsigned int>(w & mask);
+            out[idx++] = bits == 8 ? static_cast<BlockType>(v) : m_palette[v];
+        }
+    }
+}
+
+bool ChunkSection::isUniform() const {
+    return m_indices == nullptr;
+}
+
+BlockType ChunkSection::uniformType() const {
+    return m_palette[0];
+}
+
+unsigned int ChunkSection::bitsPerBlock() const {
+    return m_indices == nullptr ? 0 : m_indices->bits;
+}
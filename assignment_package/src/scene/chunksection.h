@@ -0,0 +1,69 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include <array>
+#include <vector>
+#include <cstdint>
+
+enum BlockType : unsigned char;
+
+// One ChunkSection is a 16 x 16 x 16 vertical slice of a Chunk.
+// Most sections of the world hold a single block type (all air above
+// the surface, all stone below it), so a section only stores that one
+// value until a different block is written into it.
+// Past that point blocks are stored as indices into a small local
+// palette, packed 1, 2 or 4 bits per block depending on how many types
+// the section uses. A section using more than 16 types switches to
+// 8 bits per block and stores the BlockType values directly.
+// A section must not be read while another thread writes to it; Chunk
+// guards its sections with its blocks lock.
+class ChunkSection {
+private:
+    // The packed per-block indices of a non-uniform section.
+    // The index width is stored alongside the packed words so that
+    // a reader always sees a width that matches the data it indexes.
+    struct PackedIndices {
+        unsigned int bits; // 1, 2, 4 or 8
+        std::vector<uint64_t> words;
+
+        PackedIndices(unsigned int bits);
+        unsigned int get(unsigned int idx) const;
+        void set(unsigned int idx, unsigned int v);
+    };
+
+    // Local palette used while the index width is 4 bits or less.
+    // m_palette[0] is the type of every block while the section is uniform.
+    std::array<BlockType, 16> m_palette;
+    unsigned int m_paletteSize;
+    // Null while the section is uniform
+    uPtr<PackedIndices> m_indices;
+
+    // Returns m_paletteSize if t is not in the palette
+    unsigned int paletteIndexOf(BlockType t) const;
+    // Doubles the index width, switching to raw BlockTypes at 8 bits
+    void widen();
+
+public:
+    ChunkSection();
+
+    BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
+    void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Sets every cell of this section to t and releases its index array
+    void fill(BlockType t);
+    // Rebuilds this section from a full block array, indexed like
+    // decode(), using the narrowest index width that fits the types it
+    // contains.
+    void pack(const std::array<BlockType, 4096> &blocks);
+    // Drops palette entries that are no longer used and narrows the
+    // index width (or collapses to a uniform section) where possible
+    void compact();
+    // Unpacks every block of this section into out, indexed by
+    // x + 16 * y + 256 * z
+    void decode(std::array<BlockType, 4096> &out) const;
+
+    // True if every cell of this section holds the same block type
+    bool isUniform() const;
+    // Only meaningful when isUniform() is true
+    BlockType uniformType() const;
+    // Bits used per block; 0 for a uniform section
+    unsigned int bitsPerBlock() const;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <openglcontext.h>
+#include <glm_includes.h>
+
+// Defined in chunk.h. ChunkVertex lives in its own header so that
+// vboworker.h can use it whichever of chunk.h and terrain.h is included first
+enum Direction : unsigned char;
+
+// One vertex of a chunk mesh, packed into 8 bytes and unpacked again
+// in lambert.vert.glsl and shadowMapping.vert.glsl.
+// posNor: chunk-local x (5 bits), y (9 bits), z (5 bits), the face's
+//         normal as a Direction (3 bits) and an inset flag (1 bit) that
+//         pulls the vertex 1/16 of a block in against its normal (cactus sides)
+// uv:     atlas tile x and y (4 bits each), the position within the face
+//         in blocks along u and v (9 bits each), then the animated and
+//         transparent flags (1 bit each)
+struct ChunkVertex {
+    GLuint posNor;
+    GLuint uv;
+
+    ChunkVertex(glm::ivec3 pos, Direction nor, bool inset,
+                glm::ivec2 tile, glm::ivec2 faceUV, bool animated, bool transparent)
+        : posNor(pos.x | pos.y << 5 | pos.z << 14 | nor << 19 | inset << 22),
+          uv(tile.x | tile.y << 4 | faceUV.x << 8 | faceUV.y << 17 | animated << 26 | transparent << 27)
+    {}
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+// What a random stream is drawn for, so that streams for different
+// purposes at the same place never share numbers
+enum RngStream : uint32_t {
+    RNG_RIVER
+};
+
+// Scrambles the bits of x so that nearby inputs give unrelated outputs
+// (the SplitMix64 finalizer)
+inline uint64_t mixBits(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// The key of the world's random stream for purpose at world-space (x, z)
+inline uint64_t streamKey(uint64_t seed, RngStream purpose, int x, int z) {
+    uint64_t xz = (uint64_t(uint32_t(x)) << 32) | uint32_t(z);
+    return mixBits(mixBits(seed ^ (uint64_t(purpose) << 56)) ^ xz);
+}
+
+// A counter-based random number generator: the nth number of a stream is
+// a hash of its key and n. Unlike rand() it keeps no shared state, so a
+// stream keyed by the world seed and a position gives the same numbers
+// whichever thread draws them and whatever was generated before.
+class CounterRng {
+private:
+    uint64_t m_key;
+    uint64_t m_counter;
+
+public:
+    explicit CounterRng(uint64_t key) : m_key(key), m_counter(0) {}
+
+    uint64_t next() {
+        return mixBits(m_key + 0x9e3779b97f4a7c15ull * ++m_counter);
+    }
+    // Uniform in [0, 1)
+    float nextFloat() {
+        return float(next() >> 40) * (1.f / 16777216.f);
+    }
+};
@@ -6,12 +6,12 @@ Entity::Entity()
 
 Entity::Entity(glm::vec3 pos)
     : m_forward(0,0,-1), m_right(1,0,0), m_up(0,1,0), m_position(pos),m_posPrev(pos),
-      mcr_position(m_position), mcr_posPrev(m_posPrev)
+      mcr_position(m_position), mcr_posPrev(m_posPrev), mcr_forward(m_forward)
 {}
 
 Entity::Entity(const Entity &e)
     : m_forward(e.m_forward), m_right(e.m_right), m_up(e.m_up), m_position(e.m_position), m_posPrev(e.m_posPrev),
-      mcr_position(m_position), mcr_posPrev(m_posPrev)
+      mcr_position(m_position), mcr_posPrev(m_posPrev), mcr_forward(m_forward)
 {}
 
 Entity::~Entity()
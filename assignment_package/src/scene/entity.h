@@ -26,6 +26,7 @@ public:
     // A readonly reference to position for external use
     const glm::vec3& mcr_position;
     const glm::vec3& mcr_posPrev;
+    const glm::vec3& mcr_forward;
 
     // Various constructors
     Entity();
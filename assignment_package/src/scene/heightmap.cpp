@@ -1,35 +1,161 @@
 #include "heightmap.h"
+#include "noisekernels.h"
+#include "counterrng.h"
+#include <QReadWriteLock>
+#include <deque>
+#include <unordered_map>
 
 using namespace glm;
 
-float HeightMap::random1( float x, float z ) {
+// The constants of the hash functions below. The world seed nudges each
+// dot product's weights and adds a phase to it, which gives unrelated
+// hashes for every seed; seed 0 leaves them as they always were.
+struct HashKeys {
+    vec2 random1[2];
+    vec2 random1Phase;
+    vec2 random2[2];
+    vec2 random2Phase;
+    vec3 random3[3];
+    vec3 random3Phase;
+};
+
+namespace {
+
+HashKeys hashKeys(uint64_t seed) {
+    const vec2 k1[2] = {vec2(154.3, 281.6), vec2(235.7, 149.1)};
+    const vec2 k2[2] = {vec2(127.1, 311.7), vec2(269.5, 183.3)};
+    const vec3 k3[3] = {vec3(127.1, 311.7, 412.6), vec3(269.5, 183.3, 789.2), vec3(420.6, 631.2, 345.2)};
+    CounterRng rng(mixBits(seed));
+    // Weights move by up to 64, phases by up to 8
+    auto offset = [&](float scale) {
+        return seed == 0 ? 0.f : rng.nextFloat() * scale;
+    };
+    HashKeys keys;
+    for (int i = 0; i < 2; ++i) {
+        keys.random1[i] = k1[i] + vec2(offset(64.f), offset(64.f));
+        keys.random2[i] = k2[i] + vec2(offset(64.f), offset(64.f));
+        keys.random1Phase[i] = offset(8.f);
+        keys.random2Phase[i] = offset(8.f);
+    }
+    for (int i = 0; i < 3; ++i) {
+        keys.random3[i] = k3[i] + vec3(offset(64.f), offset(64.f), offset(64.f));
+        keys.random3Phase[i] = offset(8.f);
+    }
+    return keys;
+}
+
+}
+
+float HeightMap::random1( float x, float z ) const {
     vec2 p = vec2(x,z);
-    return fract(sin(vec2(dot(p, vec2(154.3, 281.6)),
-                 dot(p, vec2(235.7,149.1))))
+    const HashKeys &k = *m_keys;
+    return fract(sin(vec2(dot(p, k.random1[0]),
+                 dot(p, k.random1[1])) + k.random1Phase)
                  * 63242.2581f).x;
 }
 
-vec2 random2( vec2 p ) {
-    return fract(sin(vec2(dot(p, vec2(127.1, 311.7)),
-                 dot(p, vec2(269.5,183.3))))
+namespace {
+
+vec2 random2( vec2 p, const HashKeys &k ) {
+    return fract(sin(vec2(dot(p, k.random2[0]),
+                 dot(p, k.random2[1])) + k.random2Phase)
                  * 43758.5453f);
 }
 
-vec3 random3(vec3 p) {
-    return fract(sin(vec3(dot(p,vec3(127.1, 311.7, 412.6)),
-                          dot(p,vec3(269.5, 183.3, 789.2)),
-                          dot(p,vec3(420.6, 631.2, 345.2))
-                    )) * 43758.5453f);
+vec3 random3(vec3 p, const HashKeys &k) {
+    return fract(sin(vec3(dot(p, k.random3[0]),
+                          dot(p, k.random3[1]),
+                          dot(p, k.random3[2])
+                    ) + k.random3Phase) * 43758.5453f);
 }
+// The noise lookups getHeight combines into a column's height and biome
+enum NoiseTerm : unsigned char {
+    TERM_TEMP, TERM_WET, TERM_WET_DETAIL, TERM_STD_GRASS, TERM_STD_GRASS_CELLS,
+    TERM_SHIT_GRASS, TERM_SHIT_GRASS_CELLS, TERM_SWAMP_GRASS, TERM_SWAMP_GRASS_CELLS,
+    TERM_MOUNTAIN, TERM_SPIKE, TERM_VOLCANO, TERM_VOLCANO_CELLS, TERM_ISLAND, TERM_ISLAND_CELLS
+};
+constexpr int NOISE_TERM_COUNT = TERM_ISLAND_CELLS + 1;
+
+// The terms every column needs, to find its climate and base height
+constexpr unsigned BASE_TERMS = 1u << TERM_TEMP | 1u << TERM_WET | 1u << TERM_WET_DETAIL |
+                                1u << TERM_STD_GRASS | 1u << TERM_STD_GRASS_CELLS;
+
+bool isWorleyTerm(NoiseTerm t) {
+    return t == TERM_WET || t == TERM_WET_DETAIL || t == TERM_STD_GRASS_CELLS ||
+           t == TERM_SHIT_GRASS_CELLS || t == TERM_SWAMP_GRASS_CELLS ||
+           t == TERM_VOLCANO_CELLS || t == TERM_ISLAND_CELLS;
+}
+
+// Where term t samples its noise for the column at (x, z) / 2700
+vec2 samplePoint(NoiseTerm t, float x, float z) {
+    float biomeX = x/1.5f;
+    float biomeZ = z/1.5f;
+    switch (t) {
+    case TERM_TEMP:
+    case TERM_WET:
+        return vec2(biomeX, biomeZ);
+    case TERM_WET_DETAIL:
+        return vec2(biomeX*2, biomeZ*2);
+    case TERM_STD_GRASS:
+        return vec2(x * 8, z * 8);
+    case TERM_STD_GRASS_CELLS:
+        return vec2(x * 2, z * 2);
+    case TERM_SHIT_GRASS:
+        return vec2((x+40) * 8, (z+90) * 8);
+    case TERM_SHIT_GRASS_CELLS:
+        return vec2((x+40) * 2, (z+90) * 2);
+    case TERM_SWAMP_GRASS:
+        return vec2((x*10) * 8, (z*10) * 8);
+    case TERM_SWAMP_GRASS_CELLS:
+        return vec2((x*10) * 2, (z*10) * 2);
+    case TERM_MOUNTAIN:
+        return vec2(float(x * 2.5), float(z * 2.5));
+    case TERM_SPIKE:
+        return vec2(x, z);
+    case TERM_VOLCANO:
+    case TERM_ISLAND_CELLS:
+        return vec2(x*5, z*5);
+    case TERM_VOLCANO_CELLS:
+    case TERM_ISLAND:
+        return vec2(x*4, z*4);
+    }
+    return vec2(x, z);
+}
+
+// The lattice gradients around the cell a perlinNoise call last sampled
+struct PerlinCache {
+    bool valid = false;
+    vec2 cell;
+    // Indexed 2 * dx + dy
+    vec2 gradients[4];
+};
+
+// The Voronoi points of the 3 x 3 cells around the cell a WorleyNoise
+// call last sampled
+struct WorleyCache {
+    bool valid = false;
+    vec2 cell;
+    // Indexed 3 * (y + 1) + (x + 1)
+    vec2 points[9];
+};
 
-float surflet(vec2 P, vec2 gridPoint) {
+}
+
+// One cache for every noise lookup made by getHeight, indexed by NoiseTerm.
+// Each term only uses the one of its kind.
+struct HeightCaches {
+    PerlinCache perlin[NOISE_TERM_COUNT];
+    WorleyCache worley[NOISE_TERM_COUNT];
+};
+
+namespace {
+
+float surflet(vec2 P, vec2 gridPoint, vec2 gradient) {
     // Compute falloff function by converting linear distance to a polynomial
     float distX = abs(P.x - gridPoint.x);
     float distY = abs(P.y - gridPoint.y);
-    float tX = 1 - 6 * pow(distX, 5.f) + 15 * pow(distX, 4.f) - 10 * pow(distX, 3.f);
-    float tY = 1 - 6 * pow(distY, 5.f) + 15 * pow(distY, 4.f) - 10 * pow(distY, 3.f);
-    // Get the random vector for the grid point
-    vec2 gradient = 2.f * random2(gridPoint) - vec2(1.f);
+    float tX = perlinFalloff(distX);
+    float tY = perlinFalloff(distY);
     // Get the vector from the grid point to P
     vec2 diff = P - gridPoint;
     // Get the value of our height field by dotting grid->P with our gradient
@@ -38,16 +164,33 @@ float surflet(vec2 P, vec2 gridPoint) {
     return height * tX * tY;
 }
 
-float WorleyNoise(float x, float y) {
+// Points cache at the cell holding (x, y) and returns the position within
+// that cell that WorleyNoise measures from
+vec2 worleyLattice(float x, float y, WorleyCache &cache, const HashKeys &keys) {
     vec2 uv = vec2(x,y);
     uv *= 8.0; // Now the space is 10x10 instead of 1x1. Change this to any number you want.
     vec2 uvInt = floor(uv);
     vec2 uvFract = fract(uv);
+    if (!cache.valid || cache.cell != uvInt) {
+        for(int y = -1; y <= 1; ++y) {
+            for(int x = -1; x <= 1; ++x) {
+                // Get the Voronoi centerpoint for the neighboring cell
+                cache.points[3 * (y + 1) + (x + 1)] = random2(uvInt + vec2(float(x), float(y)), keys);
+            }
+        }
+        cache.cell = uvInt;
+        cache.valid = true;
+    }
+    return uvFract;
+}
+
+float WorleyNoise(float x, float y, WorleyCache &cache, const HashKeys &keys) {
+    vec2 uvFract = worleyLattice(x, y, cache, keys);
     float minDist = 1.0; // Minimum distance initialized to max.
     for(int y = -1; y <= 1; ++y) {
         for(int x = -1; x <= 1; ++x) {
             vec2 neighbor = vec2(float(x), float(y)); // Direction in which neighbor cell lies
-            vec2 point = random2(uvInt + neighbor); // Get the Voronoi centerpoint for the neighboring cell
+            vec2 point = cache.points[3 * (y + 1) + (x + 1)];
             vec2 diff = neighbor + point - uvFract; // Distance between fragment coord and neighbor’s Voronoi point
             float dist = length(diff);
             minDist = glm::min(minDist, dist);
@@ -56,57 +199,271 @@ float WorleyNoise(float x, float y) {
     return minDist;
 }
 
-float perlinNoise(float x, float y) {
+float WorleyNoise(float x, float y, const HashKeys &keys) {
+    WorleyCache cache;
+    return WorleyNoise(x, y, cache, keys);
+}
+
+// Points cache at the cell holding (x, y) and returns the point within
+// the lattice that perlinNoise samples
+vec2 perlinLattice(float x, float y, PerlinCache &cache, const HashKeys &keys) {
+    x = x * 15.f;
+    y = y * 15.f;
+    vec2 uv = vec2(x,y);
+    vec2 cell = floor(uv);
+    if (!cache.valid || cache.cell != cell) {
+        for(int dx = 0; dx <= 1; ++dx) {
+                for(int dy = 0; dy <= 1; ++dy) {
+                        // Get the random vector for the grid point
+                        cache.gradients[2 * dx + dy] = 2.f * random2(cell + vec2(dx, dy), keys) - vec2(1.f);
+                }
+        }
+        cache.cell = cell;
+        cache.valid = true;
+    }
+    return uv;
+}
+
+float perlinNoise(float x, float y, PerlinCache &cache, const HashKeys &keys) {
         float surfletSum = 0.f;
-        x = x * 15.f;
-        y = y * 15.f;
-        vec2 uv = vec2(x,y);
+        vec2 uv = perlinLattice(x, y, cache, keys);
         // Iterate over the four integer corners surrounding uv
         for(int dx = 0; dx <= 1; ++dx) {
                 for(int dy = 0; dy <= 1; ++dy) {
-                        surfletSum += surflet(uv, floor(uv) + vec2(dx, dy));
+                        surfletSum += surflet(uv, cache.cell + vec2(dx, dy), cache.gradients[2 * dx + dy]);
                 }
         }
         // abs for lines and shet
         return surfletSum;
 }
 
-float surflet3d(vec3 p, vec3 gridPoint) {
+float sampleNoise(NoiseTerm t, float x, float z, HeightCaches &caches, const HashKeys &keys) {
+    vec2 p = samplePoint(t, x, z);
+    if (isWorleyTerm(t)) {
+        return WorleyNoise(p.x, p.y, caches.worley[t], keys);
+    }
+    return perlinNoise(p.x, p.y, caches.perlin[t], keys);
+}
+
+// Writes term t of the 16 columns of row z of the tile at (xC, zC) to
+// noise[NOISE_TERM_COUNT * column + t], gathering each column's lattice
+// data through caches and evaluating the row with the noise kernels
+void sampleNoiseRow(NoiseTerm t, int xC, int zC, int z, HeightCaches &caches,
+                    const HashKeys &keys, float *noise) {
+    float out[NOISE_BATCH];
+    float z2700 = (float) (zC + z) / 2700.f;
+    if (isWorleyTerm(t)) {
+        WorleyBatch batch;
+        WorleyCache &cache = caches.worley[t];
+        for (int x = 0; x < NOISE_BATCH; ++x) {
+            vec2 p = samplePoint(t, (float) (xC + x) / 2700.f, z2700);
+            vec2 uvFract = worleyLattice(p.x, p.y, cache, keys);
+            batch.fx[x] = uvFract.x;
+            batch.fy[x] = uvFract.y;
+            for (int k = 0; k < 9; ++k) {
+                vec2 offset = vec2(float(k % 3 - 1), float(k / 3 - 1)) + cache.points[k];
+                batch.ox[k][x] = offset.x;
+                batch.oy[k][x] = offset.y;
+            }
+        }
+        worleyKernel(batch, out);
+    } else {
+        PerlinBatch batch;
+        PerlinCache &cache = caches.perlin[t];
+        for (int x = 0; x < NOISE_BATCH; ++x) {
+            vec2 p = samplePoint(t, (float) (xC + x) / 2700.f, z2700);
+            vec2 uv = perlinLattice(p.x, p.y, cache, keys);
+            batch.px[x] = uv.x;
+            batch.py[x] = uv.y;
+            batch.cx[x] = cache.cell.x;
+            batch.cy[x] = cache.cell.y;
+            for (int k = 0; k < 4; ++k) {
+                batch.gx[k][x] = cache.gradients[k].x;
+                batch.gy[k][x] = cache.gradients[k].y;
+            }
+        }
+        perlinKernel(batch, out);
+    }
+    for (int x = 0; x < NOISE_BATCH; ++x) {
+        noise[NOISE_TERM_COUNT * (x + 16 * z) + t] = out[x];
+    }
+}
+
+// Temperature and wetness change over thousands of blocks, so their noise
+// terms are evaluated every CLIMATE_SPACING blocks and interpolated in
+// between. Compared with evaluating them per column, over 1.6 million
+// columns around the origin 0.17% of heights change, by one block, and
+// 0.04% of biomes change, where the climate lies on a biome boundary.
+constexpr int CLIMATE_SHIFT = 2;
+constexpr int CLIMATE_SPACING = 1 << CLIMATE_SHIFT;
+constexpr NoiseTerm CLIMATE_TERMS[3] = {TERM_TEMP, TERM_WET, TERM_WET_DETAIL};
+constexpr unsigned CLIMATE_TERM_BITS = 1u << TERM_TEMP | 1u << TERM_WET | 1u << TERM_WET_DETAIL;
+// The climate terms at one lattice point, in CLIMATE_TERMS order
+typedef std::array<float, 3> ClimatePoint;
+
+// The lattice is kept in regions of CLIMATE_REGION_SIZE x CLIMATE_REGION_SIZE
+// points, 64 x 64 columns like a terrain zone, indexed x + CLIMATE_REGION_SIZE * z
+// from the region's lower-left point. A region is evaluated whole the first
+// time any of its points is needed and never changes after that.
+constexpr int CLIMATE_REGION_SHIFT = 4;
+constexpr int CLIMATE_REGION_SIZE = 1 << CLIMATE_REGION_SHIFT;
+typedef std::array<ClimatePoint, CLIMATE_REGION_SIZE * CLIMATE_REGION_SIZE> ClimateRegion;
+
+}
+
+// The climate regions of one world evaluated most recently, shared by all
+// the chunks and threads that generate its terrain. Like ChunkMap it is split into shards that
+// each sit behind their own read-write lock, so that workers only wait on
+// each other while one of them stores a new region in the same shard.
+// Each shard keeps at most SHARD_CAPACITY regions and drops the oldest
+// beyond that; a dropped region is evaluated again if it is needed later.
+class ClimateLattice {
+private:
+    static const int SHARD_COUNT = 16;
+    // 512 regions in all, around 22 x 22 zones
+    static const size_t SHARD_CAPACITY = 32;
+
+    struct Shard {
+        QReadWriteLock lock;
+        std::unordered_map<int64_t, sPtr<const ClimateRegion>> regions;
+        // The keys of regions, oldest first
+        std::deque<int64_t> order;
+    };
+    std::array<Shard, SHARD_COUNT> m_shards;
+    const HashKeys &m_keys;
+
+    static int shardOf(int64_t key) {
+        return static_cast<int>(mixBits(static_cast<uint64_t>(key)) % SHARD_COUNT);
+    }
+
+    sPtr<const ClimateRegion> evaluate(int rx, int rz) const {
+        sPtr<ClimateRegion> region = mkS<ClimateRegion>();
+        HeightCaches caches;
+        for (int i = 0; i < CLIMATE_REGION_SIZE * CLIMATE_REGION_SIZE; ++i) {
+            int lx = (rx << CLIMATE_REGION_SHIFT) + i % CLIMATE_REGION_SIZE;
+            int lz = (rz << CLIMATE_REGION_SHIFT) + i / CLIMATE_REGION_SIZE;
+            float x = (float) (lx * CLIMATE_SPACING) / 2700.f;
+            float z = (float) (lz * CLIMATE_SPACING) / 2700.f;
+            for (int k = 0; k < 3; ++k) {
+                (*region)[i][k] = sampleNoise(CLIMATE_TERMS[k], x, z, caches, m_keys);
+            }
+        }
+        return region;
+    }
+
+    // Region (rx, rz), evaluating it if no shard holds it. Stays valid for
+    // as long as the caller keeps it, even if its shard drops it meanwhile.
+    sPtr<const ClimateRegion> region(int rx, int rz) {
+        int64_t key = Terrain::toKey(rx, rz);
+        Shard &s = m_shards[shardOf(key)];
+        {
+            QReadLocker locker(&s.lock);
+            auto it = s.regions.find(key);
+            if (it != s.regions.end()) {
+                return it->second;
+            }
+        }
+        // Evaluated outside the lock. Two threads may both evaluate a
+        // region, but always to the same values.
+        sPtr<const ClimateRegion> r = evaluate(rx, rz);
+        QWriteLocker locker(&s.lock);
+        auto inserted = s.regions.emplace(key, r);
+        if (!inserted.second) {
+            return inserted.first->second;
+        }
+        s.order.push_back(key);
+        if (s.order.size() > SHARD_CAPACITY) {
+            s.regions.erase(s.order.front());
+            s.order.pop_front();
+        }
+        return r;
+    }
+
+public:
+    explicit ClimateLattice(const HashKeys &keys) : m_shards(), m_keys(keys) {}
+
+    // Fills out with the w x h lattice points from lattice point (lx0, lz0),
+    // indexed (lx - lx0) + w * (lz - lz0), evaluating the regions not held.
+    void get(int lx0, int lz0, int w, int h, ClimatePoint *out) {
+        sPtr<const ClimateRegion> r;
+        int rx = 0, rz = 0;
+        for (int i = 0; i < w * h; ++i) {
+            int lx = lx0 + i % w;
+            int lz = lz0 + i / w;
+            if (r == nullptr || lx >> CLIMATE_REGION_SHIFT != rx || lz >> CLIMATE_REGION_SHIFT != rz) {
+                rx = lx >> CLIMATE_REGION_SHIFT;
+                rz = lz >> CLIMATE_REGION_SHIFT;
+                r = region(rx, rz);
+            }
+            out[i] = (*r)[(lx & (CLIMATE_REGION_SIZE - 1)) +
+                          CLIMATE_REGION_SIZE * (lz & (CLIMATE_REGION_SIZE - 1))];
+        }
+    }
+};
+
+namespace {
+
+// Writes the climate terms of column (xC, zC) to noise, interpolated
+// between the four lattice points around it, which lattice must hold as
+// filled by ClimateLattice::get
+void interpolateClimate(int xC, int zC, const ClimatePoint *lattice,
+                        int lx0, int lz0, int w, float *noise) {
+    int lx = xC >> CLIMATE_SHIFT;
+    int lz = zC >> CLIMATE_SHIFT;
+    float fx = float(xC - lx * CLIMATE_SPACING) / CLIMATE_SPACING;
+    float fz = float(zC - lz * CLIMATE_SPACING) / CLIMATE_SPACING;
+    const ClimatePoint *p00 = lattice + (lx - lx0) + w * (lz - lz0);
+    const ClimatePoint *p01 = p00 + w;
+    for (int k = 0; k < 3; ++k) {
+        noise[CLIMATE_TERMS[k]] = mix(mix(p00[0][k], p00[1][k], fx),
+                                      mix(p01[0][k], p01[1][k], fx), fz);
+    }
+}
+
+float surflet3d(vec3 p, vec3 gridPoint, const HashKeys &keys) {
    // Compute the distance between p and the grid point along each axis, and warp it with a
    // quintic function so we can smooth our cells
    vec3 t2 = abs(p - gridPoint);
-   vec3 t = vec3(1.f) - 6.f * pow(t2.x, 5.f) + 15.f * pow(t2.y, 4.f) - 10.f * pow(t2.z, 3.f);
+   float t = perlin3Falloff(t2.x, t2.y, t2.z);
    // Get the random vector for the grid point (assume we wrote a function random2
    // that returns a vec2 in the range [0, 1])
-   vec3 gradient = random3(gridPoint) * 2.f - vec3(1., 1., 1.);
+   vec3 gradient = random3(gridPoint, keys) * 2.f - vec3(1., 1., 1.);
    // Get the vector from the grid point to P
    vec3 diff = p - gridPoint;
    // Get the value of our height field by dotting grid->P with our gradient
    float height = dot(diff, gradient);
    // Scale our height field (i.e. reduce it) by our polynomial falloff function
-   return height * t.x * t.y * t.z;
+   return height * t * t * t;
 }
 
-float perlinNoise3d(float x, float y, float z) {
+float perlinNoise3d(float x, float y, float z, const HashKeys &keys) {
     float surfletSum = 0.f;
     vec3 uv = vec3(x,y,z);
     for(int dx = 0; dx <= 1; ++dx) {
         for(int dy = 0; dy <= 1; ++dy) {
             for(int dz = 0; dz <= 1; ++dz) {
-                surfletSum += surflet3d(uv, floor(uv) + vec3(dx, dy, dz));
+                surfletSum += surflet3d(uv, floor(uv) + vec3(dx, dy, dz), keys);
             }
         }
     }
     return surfletSum;
 }
 
-HeightMap::HeightMap()
-{
+}
+
+HeightMap::HeightMap(uint64_t seed)
+    : m_seed(seed), m_keys(mkU<HashKeys>(hashKeys(seed))),
+      m_climate(mkU<ClimateLattice>(*m_keys))
+{}
 
+HeightMap::~HeightMap() {}
+
+uint64_t HeightMap::seed() const {
+    return m_seed;
 }
 
-int HeightMap::boulderHeight(int xC, int zC) {
-    float noise = WorleyNoise(xC/200.f, zC/200.f);
+int HeightMap::boulderHeight(int xC, int zC) const {
+    float noise = WorleyNoise(xC/200.f, zC/200.f, *m_keys);
     if (noise < 0.035) {
         return 3;
     } else if (noise < 0.08) {
@@ -117,63 +474,139 @@ int HeightMap::boulderHeight(int xC, int zC) {
     return 0;
 }
 
-boolean HeightMap::hasCactus(int xC, int zC) {
-    return WorleyNoise(xC/2.f, zC/2.f) < 0.045;
+boolean HeightMap::hasCactus(int xC, int zC) const {
+    return WorleyNoise(xC/2.f, zC/2.f, *m_keys) < 0.045;
 }
 
-float HeightMap::grassHeight(float x, float y) {
-    float val = 1.f + perlinNoise(x * 8, y * 8);
+float HeightMap::grassHeight(float perlin, float cells) {
+    float val = 1.f + perlin;
     val = pow(val, 0.2f);
     val -= 0.5f;
     val = glm::clamp(val, 0.f, 1.f);
-    val += (1 - WorleyNoise(x*2,y*2)) * 0.8;
+    val += (1 - cells) * 0.8;
     return val;
 }
 
-float HeightMap::mountainHeight(float x, float y) {
-    float val = 0.8f + perlinNoise(x * 2.5, y * 2.5);
+float HeightMap::mountainHeight(float perlin) {
+    float val = 0.8f + perlin;
     val = pow(val, 3.f);
     val -= 0.4;
     return glm::clamp(val, 0.f, 1.f);
 }
 
-float HeightMap::spikeHeight(float x, float y) {
-    float val = 0.8f + perlinNoise(x, y);
+float HeightMap::spikeHeight(float perlin) {
+    float val = 0.8f + perlin;
     val = pow(val, 3.f);
     val -= 0.4;
     return val;
 }
 
-
-std::pair<int, Biome> HeightMap::getHeight(int xC, int zC) {
-    float x = (float) xC / 2700.f;
-    float z = (float) zC / 2700.f;
-    //TODO: move random calculations to if statements so we only calculate 4 heights
-    // instead of 9
-    float biomeX = x/1.5f;
-    float biomeZ = z/1.5f;
-    float temp = perlinNoise(biomeX, biomeZ);
+void HeightMap::climate(const float *noise, float &temp, float &wet) {
+    temp = noise[TERM_TEMP];
     temp += 0.5;
     temp = 0.5*(smoothstep(0.3f, 0.4f, temp) + smoothstep(0.58f, 0.68f, temp));
-    float stdGrass = grassHeight(x,z);
-    float wet = WorleyNoise(biomeX, biomeZ)*0.7 + WorleyNoise(biomeX*2, biomeZ*2)*0.3;
+    wet = noise[TERM_WET]*0.7 + noise[TERM_WET_DETAIL]*0.3;
     wet = 0.5*(smoothstep(0.27f, 0.38f, wet) + smoothstep(0.58f, 0.68f, wet));
-//    float iceSpikes = pow(spikeHeight(x, z) * 1.8, 4) + 11;
-//    float swamp = 12;
-//    float island = (1 - WorleyNoise(x*5, z*5)) * 14 + perlinNoise(x*4, z*4) * 8;
-//    float tundra = stdGrass * 19;
-//    float grassland = stdGrass * 16;
-//    float volcano = pow((1 - WorleyNoise(x*4, z*4)), 1.5) * 10 + perlinNoise(x*5, z*5)*2;
-//    volcano = pow(volcano, 1.6f) + 5;
-//    float shitland = stdGrass * 10 + 2;
-//    float desert = stdGrass * 10 + 4;
-//    float desertMountain = mountainHeight(x, z) * 44 + 6;
+}
+
+unsigned HeightMap::termsNeeded(const float *noise) {
+    float temp, wet;
+    climate(noise, temp, wet);
+    if (wet < 0.5) {
+        if (temp < 0.5) {
+            return BASE_TERMS | 1u << TERM_SHIT_GRASS | 1u << TERM_SHIT_GRASS_CELLS;
+        }
+        return BASE_TERMS | 1u << TERM_MOUNTAIN | 1u << TERM_VOLCANO | 1u << TERM_VOLCANO_CELLS;
+    }
+    if (temp < 0.5) {
+        return BASE_TERMS | 1u << TERM_SPIKE | 1u << TERM_SWAMP_GRASS | 1u << TERM_SWAMP_GRASS_CELLS;
+    }
+    return BASE_TERMS | 1u << TERM_VOLCANO | 1u << TERM_VOLCANO_CELLS |
+           1u << TERM_SWAMP_GRASS | 1u << TERM_SWAMP_GRASS_CELLS | 1u << TERM_ISLAND | 1u << TERM_ISLAND_CELLS;
+}
+
+std::pair<int, Biome> HeightMap::getHeight(int xC, int zC) const {
+    HeightCaches caches;
+    return getHeight(xC, zC, caches);
+}
+
+void HeightMap::getHeightTile(int xC, int zC, HeightTile &tile) const {
+    HeightCaches caches;
+    // Indexed NOISE_TERM_COUNT * (x + 16 * z) + NoiseTerm
+    float noise[NOISE_TERM_COUNT * 256];
+    int lx0 = xC >> CLIMATE_SHIFT;
+    int lz0 = zC >> CLIMATE_SHIFT;
+    int w = ((xC + 15) >> CLIMATE_SHIFT) - lx0 + 2;
+    int h = ((zC + 15) >> CLIMATE_SHIFT) - lz0 + 2;
+    ClimatePoint lattice[36];
+    m_climate->get(lx0, lz0, w, h, lattice);
+    for (int z = 0; z < 16; ++z) {
+        for (int x = 0; x < 16; ++x) {
+            interpolateClimate(xC + x, zC + z, lattice, lx0, lz0, w,
+                               noise + NOISE_TERM_COUNT * (x + 16 * z));
+        }
+    }
+    // Every term any column of the tile needs is evaluated for the whole
+    // tile, as most tiles lie in a single biome quadrant
+    for (int t = 0; t < NOISE_TERM_COUNT; ++t) {
+        if ((BASE_TERMS & ~CLIMATE_TERM_BITS) & (1u << t)) {
+            for (int z = 0; z < 16; ++z) {
+                sampleNoiseRow(NoiseTerm(t), xC, zC, z, caches, *m_keys, noise);
+            }
+        }
+    }
+    unsigned needed = 0;
+    for (int i = 0; i < 256; ++i) {
+        needed |= termsNeeded(noise + NOISE_TERM_COUNT * i);
+    }
+    for (int t = 0; t < NOISE_TERM_COUNT; ++t) {
+        if ((needed & ~BASE_TERMS) & (1u << t)) {
+            for (int z = 0; z < 16; ++z) {
+                sampleNoiseRow(NoiseTerm(t), xC, zC, z, caches, *m_keys, noise);
+            }
+        }
+    }
+    for (int i = 0; i < 256; ++i) {
+        std::pair<int, Biome> ground = combineNoise(noise + NOISE_TERM_COUNT * i);
+        tile.heights[i] = ground.first;
+        tile.biomes[i] = ground.second;
+    }
+}
+
+std::pair<int, Biome> HeightMap::getHeight(int xC, int zC, HeightCaches &caches) const {
+    float x = (float) xC / 2700.f;
+    float z = (float) zC / 2700.f;
+    float noise[NOISE_TERM_COUNT];
+    int lx0 = xC >> CLIMATE_SHIFT;
+    int lz0 = zC >> CLIMATE_SHIFT;
+    ClimatePoint lattice[4];
+    m_climate->get(lx0, lz0, 2, 2, lattice);
+    interpolateClimate(xC, zC, lattice, lx0, lz0, 2, noise);
+    for (int t = 0; t < NOISE_TERM_COUNT; ++t) {
+        if ((BASE_TERMS & ~CLIMATE_TERM_BITS) & (1u << t)) {
+            noise[t] = sampleNoise(NoiseTerm(t), x, z, caches, *m_keys);
+        }
+    }
+    // Only the terms of this column's biome quadrant
+    unsigned needed = termsNeeded(noise) & ~BASE_TERMS;
+    for (int t = 0; t < NOISE_TERM_COUNT; ++t) {
+        if (needed & (1u << t)) {
+            noise[t] = sampleNoise(NoiseTerm(t), x, z, caches, *m_keys);
+        }
+    }
+    return combineNoise(noise);
+}
+
+std::pair<int, Biome> HeightMap::combineNoise(const float *noise) {
+    float temp, wet;
+    climate(noise, temp, wet);
+    float stdGrass = grassHeight(noise[TERM_STD_GRASS], noise[TERM_STD_GRASS_CELLS]);
     float h1, h2;
     int height;
     if (wet < 0.5) {
         // BOTTOM LEFT
         if (temp < 0.5) {
-            float shitland = grassHeight(x+40,z+90)*3 + stdGrass * 7 + 2;
+            float shitland = grassHeight(noise[TERM_SHIT_GRASS], noise[TERM_SHIT_GRASS_CELLS])*3 + stdGrass * 7 + 2;
             float desert = stdGrass * 10 + 4;
             float tundra = stdGrass * 19;
             float grassland = stdGrass * 16;
@@ -184,10 +617,10 @@ std::pair<int, Biome> HeightMap::getHeight(int xC, int zC) {
         // BOTTOM RIGHT
         else {
             float desert = stdGrass * 10 + 4;
-            float desertMountain = mountainHeight(x, z) * 44 + 6;
+            float desertMountain = mountainHeight(noise[TERM_MOUNTAIN]) * 44 + 6;
             float grassland = stdGrass * 16;
-            float volcano = pow((1 - WorleyNoise(x*4, z*4)), 1.5) * 10 + perlinNoise(x*5, z*5)*2;
-            volcano = pow(volcano, 1.6f) + 5;
+            float volcano = pow((1 - noise[TERM_VOLCANO_CELLS]), 1.5) * 10 + noise[TERM_VOLCANO]*2;
+            volcano = pow(std::max(volcano, 0.f), 1.6f) + 5;
             h1 = mix(desert, desertMountain, (temp-0.499999) * 2);
             h2 = mix(grassland, volcano, (temp-0.499999) * 2);
             height = 128 + mix(h1, h2, wet*2);
@@ -198,8 +631,8 @@ std::pair<int, Biome> HeightMap::getHeight(int xC, int zC) {
         if (temp < 0.5) {
             float tundra = stdGrass * 19;
             float grassland = stdGrass * 16;
-            float iceSpikes = pow(spikeHeight(x, z) * 1.8, 4) + 11;
-            float swamp = grassHeight(x*10, z*10)*3 + 7;
+            float iceSpikes = pow(spikeHeight(noise[TERM_SPIKE]) * 1.8, 4) + 11;
+            float swamp = grassHeight(noise[TERM_SWAMP_GRASS], noise[TERM_SWAMP_GRASS_CELLS])*3 + 7;
             h1 = mix(tundra, grassland, temp * 2);
             h2 = mix(iceSpikes, swamp, temp * 2);
             height = 128 + mix(h1, h2, (wet-0.499999)*2);
@@ -207,10 +640,10 @@ std::pair<int, Biome> HeightMap::getHeight(int xC, int zC) {
         // TOP RIGHT
         else {
             float grassland = stdGrass * 16;
-            float volcano = pow((1 - WorleyNoise(x*4, z*4)), 1.5) * 10 + perlinNoise(x*5, z*5)*2;
-            volcano = pow(volcano, 1.6f) + 5;
-            float swamp = grassHeight(x*10, z*10)*3 + 7;
-            float island = (1 - WorleyNoise(x*5, z*5)) * 14 + perlinNoise(x*4, z*4) * 8;
+            float volcano = pow((1 - noise[TERM_VOLCANO_CELLS]), 1.5) * 10 + noise[TERM_VOLCANO]*2;
+            volcano = pow(std::max(volcano, 0.f), 1.6f) + 5;
+            float swamp = grassHeight(noise[TERM_SWAMP_GRASS], noise[TERM_SWAMP_GRASS_CELLS])*3 + 7;
+            float island = (1 - noise[TERM_ISLAND_CELLS]) * 14 + noise[TERM_ISLAND] * 8;
             h1 = mix(grassland, volcano, (temp-0.499999) * 2);
             h2 = mix(swamp, island, (temp-0.499999) * 2);
             height = 128 + mix(h1, h2, (wet-0.499999)*2);
@@ -245,9 +678,13 @@ std::pair<int, Biome> HeightMap::getHeight(int xC, int zC) {
     return std::pair(height, biomeType);
 }
 
-BlockType HeightMap::getDepth(int x, int y, int z) {
-    float perlin = perlinNoise3d(x/15.f,y/15.f,z/15.f);
+BlockType HeightMap::getDepth(int x, int y, int z) const {
+    float perlin = perlinNoise3d(x/15.f,y/15.f,z/15.f, *m_keys);
     //std::cout << "Perlin Noise: " << perlin << std::endl;
+    return depthBlock(perlin, y);
+}
+
+BlockType HeightMap::depthBlock(float perlin, int y) {
     if (perlin > 0.f) {
         return STONE;
     } else {
@@ -257,3 +694,153 @@ BlockType HeightMap::getDepth(int x, int y, int z) {
         return EMPTY;
     }
 }
+
+namespace {
+
+// FAST_CAVES samples the cave noise every CAVE_SPACING blocks along each
+// axis, from y = 0 to 128, and interpolates between the samples
+constexpr int CAVE_SHIFT = 2;
+constexpr int CAVE_SPACING = 1 << CAVE_SHIFT;
+constexpr int CAVE_LATTICE_XZ = 16 / CAVE_SPACING + 1;
+constexpr int CAVE_LATTICE_Y = 128 / CAVE_SPACING + 1;
+constexpr int CAVE_LATTICE_SIZE = CAVE_LATTICE_XZ * CAVE_LATTICE_XZ * CAVE_LATTICE_Y;
+
+int caveLatticeIndex(int i, int j, int k) {
+    return i + CAVE_LATTICE_XZ * (k + CAVE_LATTICE_XZ * j);
+}
+
+// Fills lattice with perlinNoise3d at every cave lattice point of the chunk
+// at (xC, zC), indexed by caveLatticeIndex. The gradients of the lattice
+// cells the chunk overlaps are hashed once, and the samples are evaluated
+// NOISE_BATCH at a time by perlin3Kernel.
+void caveLattice(int xC, int zC, const HashKeys &keys, float *lattice) {
+    // A chunk spans at most 3 noise cells along x and z, and y = 0 to 128
+    // spans 9; these hold the gradients at their corners
+    ivec3 cellMin = ivec3(floor(vec3(xC / 15.f, 0.f, zC / 15.f)));
+    vec3 gradients[4][10][4];
+    for (int x = 0; x < 4; ++x) {
+        for (int y = 0; y < 10; ++y) {
+            for (int z = 0; z < 4; ++z) {
+                vec3 gridPoint = vec3(cellMin + ivec3(x, y, z));
+                gradients[x][y][z] = random3(gridPoint, keys) * 2.f - vec3(1., 1., 1.);
+            }
+        }
+    }
+    Perlin3Batch batch;
+    float out[NOISE_BATCH];
+    for (int first = 0; first < CAVE_LATTICE_SIZE; first += NOISE_BATCH) {
+        for (int lane = 0; lane < NOISE_BATCH; ++lane) {
+            // Lanes past the end repeat the last point
+            int n = glm::min(first + lane, CAVE_LATTICE_SIZE - 1);
+            int i = n % CAVE_LATTICE_XZ;
+            int k = (n / CAVE_LATTICE_XZ) % CAVE_LATTICE_XZ;
+            int j = n / (CAVE_LATTICE_XZ * CAVE_LATTICE_XZ);
+            vec3 p = vec3((xC + CAVE_SPACING * i) / 15.f, (CAVE_SPACING * j) / 15.f,
+                          (zC + CAVE_SPACING * k) / 15.f);
+            vec3 cell = floor(p);
+            ivec3 g = ivec3(cell) - cellMin;
+            batch.px[lane] = p.x;
+            batch.py[lane] = p.y;
+            batch.pz[lane] = p.z;
+            batch.cx[lane] = cell.x;
+            batch.cy[lane] = cell.y;
+            batch.cz[lane] = cell.z;
+            for (int c = 0; c < 8; ++c) {
+                vec3 gradient = gradients[g.x + (c >> 2)][g.y + ((c >> 1) & 1)][g.z + (c & 1)];
+                batch.gx[c][lane] = gradient.x;
+                batch.gy[c][lane] = gradient.y;
+                batch.gz[c][lane] = gradient.z;
+            }
+        }
+        perlin3Kernel(batch, out);
+        for (int lane = 0; lane < NOISE_BATCH && first + lane < CAVE_LATTICE_SIZE; ++lane) {
+            lattice[first + lane] = out[lane];
+        }
+    }
+}
+
+}
+
+void HeightMap::carveCaves(Chunk *c, CaveMode mode) const {
+    c->fillLayers(1, 127, STONE);
+    if (mode == NO_CAVES) {
+        return;
+    }
+    int xC = c->mcr_origin.x;
+    int zC = c->mcr_origin.y;
+    if (mode == EXACT_CAVES) {
+        for(int zl = 0; zl < 16; ++zl) {
+            for(int yl = 1; yl < 128; ++yl) {
+                for(int xl = 0; xl < 16; ++xl) {
+                    BlockType b = getDepth(xC + xl, yl, zC + zl);
+                    if (b != STONE) {
+                        c->setBlockAt(xl, yl, zl, b);
+                    }
+                }
+            }
+        }
+        return;
+    }
+    float lattice[CAVE_LATTICE_SIZE];
+    caveLattice(xC, zC, *m_keys, lattice);
+    std::array<BlockType, 4096> blocks;
+    for (int sy = 0; sy < 8; ++sy) {
+        // A section whose samples are all positive is all stone, as
+        // interpolating between them never crosses zero
+        bool solid = true;
+        for (int j = 4 * sy; j <= 4 * sy + 4 && solid; ++j) {
+            for (int n = 0; n < CAVE_LATTICE_XZ * CAVE_LATTICE_XZ && solid; ++n) {
+                solid = lattice[caveLatticeIndex(n % CAVE_LATTICE_XZ, j, n / CAVE_LATTICE_XZ)] > 0.f;
+            }
+        }
+        if (solid) {
+            continue;
+        }
+        // Carved a whole section at a time, as most of its blocks change
+        c->getSection(sy).decode(blocks);
+        for (int j = 4 * sy; j < 4 * sy + 4; ++j) {
+            for (int k = 0; k < CAVE_LATTICE_XZ - 1; ++k) {
+                for (int i = 0; i < CAVE_LATTICE_XZ - 1; ++i) {
+                    // Indexed 4 * dy + 2 * dz + dx
+                    float corners[8];
+                    bool anyStone = false;
+                    bool allStone = true;
+                    for (int n = 0; n < 8; ++n) {
+                        corners[n] = lattice[caveLatticeIndex(i + (n & 1), j + (n >> 2), k + ((n >> 1) & 1))];
+                        anyStone |= corners[n] > 0.f;
+                        allStone &= corners[n] > 0.f;
+                    }
+                    if (allStone) {
+                        continue;
+                    }
+                    for (int z = 0; z < CAVE_SPACING; ++z) {
+                        float fz = float(z) / CAVE_SPACING;
+                        for (int x = 0; x < CAVE_SPACING; ++x) {
+                            // Interpolated across the cell's bottom and top
+                            // faces once per column, then along y
+                            float bottom = 0.f;
+                            float top = 0.f;
+                            if (anyStone) {
+                                float fx = float(x) / CAVE_SPACING;
+                                bottom = mix(mix(corners[0], corners[1], fx),
+                                             mix(corners[2], corners[3], fx), fz);
+                                top = mix(mix(corners[4], corners[5], fx),
+                                          mix(corners[6], corners[7], fx), fz);
+                            }
+                            int column = (CAVE_SPACING * i + x) + 256 * (CAVE_SPACING * k + z);
+                            for (int y = 0; y < CAVE_SPACING; ++y) {
+                                int yl = CAVE_SPACING * j + y;
+                                if (yl == 0) {
+                                    continue;
+                                }
+                                float perlin = mix(bottom, top, float(y) / CAVE_SPACING);
+                                blocks[column + 16 * (yl & 15)] = depthBlock(perlin, yl);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        c->setSection(sy, blocks);
+    }
+}
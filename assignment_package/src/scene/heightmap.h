@@ -1,24 +1,77 @@
 #pragma once
+#include "smartpointerhelp.h"
 #include "chunk.h"
+#include "blockregistry.h"
+#include "heighttile.h"
 #include <iostream>
 
-enum Biome : unsigned char {
-    ICE_SPIKES, SWAMP, ISLAND, TUNDRA, GRASSLAND, VOLCANO,
-    SHITLAND, DESERT, DESERT_MOUNTAIN
+class Chunk;
+
+// The noise lattice points last looked up by each noise term of
+// getHeight. Defined in heightmap.cpp.
+struct HeightCaches;
+// The constants a world's seed gives its noise hashes, and the climate
+// noise evaluated so far. Defined in heightmap.cpp.
+struct HashKeys;
+class ClimateLattice;
+
+// How the stone below y = 128 is carved into caves
+enum CaveMode : unsigned char {
+    // Solid stone
+    NO_CAVES,
+    // getDepth of every block
+    EXACT_CAVES,
+    // getDepth's noise sampled every 4 blocks and interpolated between.
+    // The caves follow the same noise with smoother walls; about 80% of
+    // underground blocks match EXACT_CAVES. tests/benchmarks/caves times
+    // each mode.
+    FAST_CAVES
 };
-enum BlockType: unsigned char;
 
+// The terrain noise of one world. Every function hashes its noise with
+// the seed the HeightMap was made with, which never changes, so any
+// number of generation threads may share one, and two worlds with
+// different seeds may generate at the same time.
 class HeightMap
 {
 private:
-    static float grassHeight(float, float);
-    static float mountainHeight(float, float);
-    static float spikeHeight(float, float);
+    uint64_t m_seed;
+    uPtr<const HashKeys> m_keys;
+    uPtr<ClimateLattice> m_climate;
+
+    // Shape the noise values of a column into terrain heights
+    static float grassHeight(float perlin, float cells);
+    static float mountainHeight(float perlin);
+    static float spikeHeight(float perlin);
+    // The temperature and wetness of a column, from its noise values
+    // indexed by the NoiseTerm enum in heightmap.cpp
+    static void climate(const float *noise, float &temp, float &wet);
+    // Bit 1 << NoiseTerm set for every noise value combineNoise will read
+    // for a column of this climate
+    static unsigned termsNeeded(const float *noise);
+    static std::pair<int, Biome> combineNoise(const float *noise);
+    // getHeight, reusing the lattice points in caches where a column
+    // falls in the same noise cells as the one before it
+    std::pair<int, Biome> getHeight(int, int, HeightCaches &caches) const;
 public:
-    HeightMap();
-    static std::pair<int, Biome> getHeight(int, int);
-    static boolean hasCactus(int, int);
-    static int boulderHeight(int, int);
-    static float random1(float, float);
-    static BlockType getDepth(int, int, int);
+    explicit HeightMap(uint64_t seed);
+    ~HeightMap();
+    uint64_t seed() const;
+    std::pair<int, Biome> getHeight(int, int) const;
+    // Fills tile with getHeight of the 16 x 16 columns whose lower-left
+    // corner is (xC, zC). Neighbouring columns mostly fall in the same
+    // noise cells, so their gradients and Worley points are hashed once
+    // for the whole tile instead of once per column, and each row of
+    // columns is evaluated at once by the SIMD kernels in noisekernels.h.
+    void getHeightTile(int xC, int zC, HeightTile &tile) const;
+    boolean hasCactus(int, int) const;
+    int boulderHeight(int, int) const;
+    float random1(float, float) const;
+    BlockType getDepth(int, int, int) const;
+    // The block getDepth gives at height y for cave noise perlin
+    static BlockType depthBlock(float perlin, int y);
+    // Fills the blocks of c with 1 <= y <= 127 with stone and carves caves
+    // out of it as mode says. Sections that FAST_CAVES finds solid are left
+    // uniform.
+    void carveCaves(Chunk *c, CaveMode mode) const;
 };
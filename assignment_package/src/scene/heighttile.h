@@ -0,0 +1,14 @@
+#pragma once
+#include "blockregistry.h"
+#include <array>
+
+// The ground height and biome of every column of a 16 x 16 area,
+// exactly as HeightMap::getHeight returns them
+struct HeightTile {
+    std::array<int, 256> heights;
+    std::array<Biome, 256> biomes;
+
+    // x and z relative to the tile's lower-left corner
+    int height(int x, int z) const { return heights[x + 16 * z]; }
+    Biome biome(int x, int z) const { return biomes[x + 16 * z]; }
+};
@@ -0,0 +1,349 @@
+#include "noisekernels.h"
+#include <atomic>
+#include <cmath>
+
+// SSE2 is part of every x86-64 CPU, so it needs no check at runtime.
+// AVX is checked for at runtime, which needs GCC or Clang to compile
+// one function for it without the rest of the program.
+#if defined(__SSE2__) || defined(_M_X64)
+#define NOISE_HAS_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(NOISE_HAS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define NOISE_HAS_AVX
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void perlinScalar(const PerlinBatch &b, float *out) {
+    for (int i = 0; i < NOISE_BATCH; ++i) {
+        float sum = 0.f;
+        for (int dx = 0; dx <= 1; ++dx) {
+            for (int dy = 0; dy <= 1; ++dy) {
+                int k = 2 * dx + dy;
+                float diffX = b.px[i] - (b.cx[i] + float(dx));
+                float diffY = b.py[i] - (b.cy[i] + float(dy));
+                float tX = perlinFalloff(std::abs(diffX));
+                float tY = perlinFalloff(std::abs(diffY));
+                float height = diffX * b.gx[k][i] + diffY * b.gy[k][i];
+                sum += height * tX * tY;
+            }
+        }
+        out[i] = sum;
+    }
+}
+
+void perlin3Scalar(const Perlin3Batch &b, float *out) {
+    for (int i = 0; i < NOISE_BATCH; ++i) {
+        float sum = 0.f;
+        for (int k = 0; k < 8; ++k) {
+            float diffX = b.px[i] - (b.cx[i] + float(k >> 2));
+            float diffY = b.py[i] - (b.cy[i] + float((k >> 1) & 1));
+            float diffZ = b.pz[i] - (b.cz[i] + float(k & 1));
+            float t = perlin3Falloff(std::abs(diffX), std::abs(diffY), std::abs(diffZ));
+            float height = diffX * b.gx[k][i] + diffY * b.gy[k][i] + diffZ * b.gz[k][i];
+            sum += height * t * t * t;
+        }
+        out[i] = sum;
+    }
+}
+
+void worleyScalar(const WorleyBatch &b, float *out) {
+    for (int i = 0; i < NOISE_BATCH; ++i) {
+        float minDist = 1.f;
+        for (int k = 0; k < 9; ++k) {
+            float diffX = b.ox[k][i] - b.fx[i];
+            float diffY = b.oy[k][i] - b.fy[i];
+            float dist = std::sqrt(diffX * diffX + diffY * diffY);
+            minDist = dist < minDist ? dist : minDist;
+        }
+        out[i] = minDist;
+    }
+}
+
+#ifdef NOISE_HAS_SSE2
+inline __m128 falloffSSE2(__m128 d) {
+    __m128 d3 = _mm_mul_ps(_mm_mul_ps(d, d), d);
+    __m128 d4 = _mm_mul_ps(d3, d);
+    __m128 d5 = _mm_mul_ps(d4, d);
+    __m128 t = _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(6.f), d5));
+    t = _mm_add_ps(t, _mm_mul_ps(_mm_set1_ps(15.f), d4));
+    return _mm_sub_ps(t, _mm_mul_ps(_mm_set1_ps(10.f), d3));
+}
+
+void perlinSSE2(const PerlinBatch &b, float *out) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (int i = 0; i < NOISE_BATCH; i += 4) {
+        __m128 px = _mm_load_ps(b.px + i);
+        __m128 py = _mm_load_ps(b.py + i);
+        __m128 cx = _mm_load_ps(b.cx + i);
+        __m128 cy = _mm_load_ps(b.cy + i);
+        __m128 sum = _mm_setzero_ps();
+        for (int dx = 0; dx <= 1; ++dx) {
+            for (int dy = 0; dy <= 1; ++dy) {
+                int k = 2 * dx + dy;
+                __m128 diffX = _mm_sub_ps(px, _mm_add_ps(cx, _mm_set1_ps(float(dx))));
+                __m128 diffY = _mm_sub_ps(py, _mm_add_ps(cy, _mm_set1_ps(float(dy))));
+                __m128 tX = falloffSSE2(_mm_and_ps(diffX, absMask));
+                __m128 tY = falloffSSE2(_mm_and_ps(diffY, absMask));
+                __m128 height = _mm_add_ps(_mm_mul_ps(diffX, _mm_load_ps(b.gx[k] + i)),
+                                           _mm_mul_ps(diffY, _mm_load_ps(b.gy[k] + i)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_mul_ps(height, tX), tY));
+            }
+        }
+        _mm_storeu_ps(out + i, sum);
+    }
+}
+
+void perlin3SSE2(const Perlin3Batch &b, float *out) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (int i = 0; i < NOISE_BATCH; i += 4) {
+        __m128 px = _mm_load_ps(b.px + i);
+        __m128 py = _mm_load_ps(b.py + i);
+        __m128 pz = _mm_load_ps(b.pz + i);
+        __m128 cx = _mm_load_ps(b.cx + i);
+        __m128 cy = _mm_load_ps(b.cy + i);
+        __m128 cz = _mm_load_ps(b.cz + i);
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < 8; ++k) {
+            __m128 diffX = _mm_sub_ps(px, _mm_add_ps(cx, _mm_set1_ps(float(k >> 2))));
+            __m128 diffY = _mm_sub_ps(py, _mm_add_ps(cy, _mm_set1_ps(float((k >> 1) & 1))));
+            __m128 diffZ = _mm_sub_ps(pz, _mm_add_ps(cz, _mm_set1_ps(float(k & 1))));
+            __m128 ax = _mm_and_ps(diffX, absMask);
+            __m128 ay = _mm_and_ps(diffY, absMask);
+            __m128 az = _mm_and_ps(diffZ, absMask);
+            __m128 x5 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(ax, ax), ax), ax), ax);
+            __m128 y4 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(ay, ay), ay), ay);
+            __m128 z3 = _mm_mul_ps(_mm_mul_ps(az, az), az);
+            __m128 t = _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(6.f), x5));
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_set1_ps(15.f), y4));
+            t = _mm_sub_ps(t, _mm_mul_ps(_mm_set1_ps(10.f), z3));
+            __m128 height = _mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX, _mm_load_ps(b.gx[k] + i)),
+                                                  _mm_mul_ps(diffY, _mm_load_ps(b.gy[k] + i))),
+                                       _mm_mul_ps(diffZ, _mm_load_ps(b.gz[k] + i)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(height, t), t), t));
+        }
+        _mm_storeu_ps(out + i, sum);
+    }
+}
+
+void worleySSE2(const WorleyBatch &b, float *out) {
+    for (int i = 0; i < NOISE_BATCH; i += 4) {
+        __m128 fx = _mm_load_ps(b.fx + i);
+        __m128 fy = _mm_load_ps(b.fy + i);
+        __m128 minDist = _mm_set1_ps(1.f);
+        for (int k = 0; k < 9; ++k) {
+            __m128 diffX = _mm_sub_ps(_mm_load_ps(b.ox[k] + i), fx);
+            __m128 diffY = _mm_sub_ps(_mm_load_ps(b.oy[k] + i), fy);
+            __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(diffX, diffX),
+                                                 _mm_mul_ps(diffY, diffY)));
+            minDist = _mm_min_ps(minDist, dist);
+        }
+        _mm_storeu_ps(out + i, minDist);
+    }
+}
+#endif
+
+#ifdef NOISE_HAS_AVX
+// Always inlined, as passing a __m256 to a function that is not costs
+// more than the function does
+__attribute__((target("avx"), always_inline))
+inline __m256 falloffAVX(__m256 d) {
+    __m256 d3 = _mm256_mul_ps(_mm256_mul_ps(d, d), d);
+    __m256 d4 = _mm256_mul_ps(d3, d);
+    __m256 d5 = _mm256_mul_ps(d4, d);
+    __m256 t = _mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(_mm256_set1_ps(6.f), d5));
+    t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_set1_ps(15.f), d4));
+    return _mm256_sub_ps(t, _mm256_mul_ps(_mm256_set1_ps(10.f), d3));
+}
+
+__attribute__((target("avx")))
+void perlinAVX(const PerlinBatch &b, float *out) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    for (int i = 0; i < NOISE_BATCH; i += 8) {
+        __m256 px = _mm256_load_ps(b.px + i);
+        __m256 py = _mm256_load_ps(b.py + i);
+        __m256 cx = _mm256_load_ps(b.cx + i);
+        __m256 cy = _mm256_load_ps(b.cy + i);
+        __m256 sum = _mm256_setzero_ps();
+        for (int dx = 0; dx <= 1; ++dx) {
+            for (int dy = 0; dy <= 1; ++dy) {
+                int k = 2 * dx + dy;
+                __m256 diffX = _mm256_sub_ps(px, _mm256_add_ps(cx, _mm256_set1_ps(float(dx))));
+                __m256 diffY = _mm256_sub_ps(py, _mm256_add_ps(cy, _mm256_set1_ps(float(dy))));
+                __m256 tX = falloffAVX(_mm256_and_ps(diffX, absMask));
+                __m256 tY = falloffAVX(_mm256_and_ps(diffY, absMask));
+                __m256 height = _mm256_add_ps(_mm256_mul_ps(diffX, _mm256_load_ps(b.gx[k] + i)),
+                                              _mm256_mul_ps(diffY, _mm256_load_ps(b.gy[k] + i)));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(height, tX), tY));
+            }
+        }
+        _mm256_storeu_ps(out + i, sum);
+    }
+    // Compilers only add this themselves when optimizing; without it the
+    // SSE code that runs next stalls on the upper halves of the registers
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx")))
+void perlin3AVX(const Perlin3Batch &b, float *out) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    for (int i = 0; i < NOISE_BATCH; i += 8) {
+        __m256 px = _mm256_load_ps(b.px + i);
+        __m256 py = _mm256_load_ps(b.py + i);
+        __m256 pz = _mm256_load_ps(b.pz + i);
+        __m256 cx = _mm256_load_ps(b.cx + i);
+        __m256 cy = _mm256_load_ps(b.cy + i);
+        __m256 cz = _mm256_load_ps(b.cz + i);
+        __m256 sum = _mm256_setzero_ps();
+        for (int k = 0; k < 8; ++k) {
+            __m256 diffX = _mm256_sub_ps(px, _mm256_add_ps(cx, _mm256_set1_ps(float(k >> 2))));
+            __m256 diffY = _mm256_sub_ps(py, _mm256_add_ps(cy, _mm256_set1_ps(float((k >> 1) & 1))));
+            __m256 diffZ = _mm256_sub_ps(pz, _mm256_add_ps(cz, _mm256_set1_ps(float(k & 1))));
+            __m256 ax = _mm256_and_ps(diffX, absMask);
+            __m256 ay = _mm256_and_ps(diffY, absMask);
+            __m256 az = _mm256_and_ps(diffZ, absMask);
+            __m256 x5 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(ax, ax), ax), ax), ax);
+            __m256 y4 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(ay, ay), ay), ay);
+            __m256 z3 = _mm256_mul_ps(_mm256_mul_ps(az, az), az);
+            __m256 t = _mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(_mm256_set1_ps(6.f), x5));
+            t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_set1_ps(15.f), y4));
+            t = _mm256_sub_ps(t, _mm256_mul_ps(_mm256_set1_ps(10.f), z3));
+            __m256 height = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diffX, _mm256_load_ps(b.gx[k] + i)),
+                                                        _mm256_mul_ps(diffY, _mm256_load_ps(b.gy[k] + i))),
+                                          _mm256_mul_ps(diffZ, _mm256_load_ps(b.gz[k] + i)));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(height, t), t), t));
+        }
+        _mm256_storeu_ps(out + i, sum);
+    }
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx")))
+void worleyAVX(const WorleyBatch &b, float *out) {
+    for (int i = 0; i < NOISE_BATCH; i += 8) {
+        __m256 fx = _mm256_load_ps(b.fx + i);
+        __m256 fy = _mm256_load_ps(b.fy + i);
+        __m256 minDist = _mm256_set1_ps(1.f);
+        for (int k = 0; k < 9; ++k) {
+            __m256 diffX = _mm256_sub_ps(_mm256_load_ps(b.ox[k] + i), fx);
+            __m256 diffY = _mm256_sub_ps(_mm256_load_ps(b.oy[k] + i), fy);
+            __m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(diffX, diffX),
+                                                       _mm256_mul_ps(diffY, diffY)));
+            minDist = _mm256_min_ps(minDist, dist);
+        }
+        _mm256_storeu_ps(out + i, minDist);
+    }
+    _mm256_zeroupper();
+}
+#endif
+
+bool supported(NoiseIsa isa) {
+    switch (isa) {
+    case NOISE_SCALAR:
+        return true;
+    case NOISE_SSE2:
+#ifdef NOISE_HAS_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case NOISE_AVX:
+#ifdef NOISE_HAS_AVX
+        return __builtin_cpu_supports("avx");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+std::atomic<NoiseIsa> g_isa(bestNoiseIsa());
+
+}
+
+void perlinKernel(const PerlinBatch &batch, float *out) {
+    switch (g_isa.load(std::memory_order_relaxed)) {
+#ifdef NOISE_HAS_AVX
+    case NOISE_AVX:
+        perlinAVX(batch, out);
+        return;
+#endif
+#ifdef NOISE_HAS_SSE2
+    case NOISE_SSE2:
+        perlinSSE2(batch, out);
+        return;
+#endif
+    default:
+        perlinScalar(batch, out);
+    }
+}
+
+void perlin3Kernel(const Perlin3Batch &batch, float *out) {
+    switch (g_isa.load(std::memory_order_relaxed)) {
+#ifdef NOISE_HAS_AVX
+    case NOISE_AVX:
+        perlin3AVX(batch, out);
+        return;
+#endif
+#ifdef NOISE_HAS_SSE2
+    case NOISE_SSE2:
+        perlin3SSE2(batch, out);
+        return;
+#endif
+    default:
+        perlin3Scalar(batch, out);
+    }
+}
+
+void worleyKernel(const WorleyBatch &batch, float *out) {
+    switch (g_isa.load(std::memory_order_relaxed)) {
+#ifdef NOISE_HAS_AVX
+    case NOISE_AVX:
+        worleyAVX(batch, out);
+        return;
+#endif
+#ifdef NOISE_HAS_SSE2
+    case NOISE_SSE2:
+        worleySSE2(batch, out);
+        return;
+#endif
+    default:
+        worleyScalar(batch, out);
+    }
+}
+
+NoiseIsa bestNoiseIsa() {
+    if (supported(NOISE_AVX)) {
+        return NOISE_AVX;
+    }
+    if (supported(NOISE_SSE2)) {
+        return NOISE_SSE2;
+    }
+    return NOISE_SCALAR;
+}
+
+NoiseIsa noiseIsa() {
+    return g_isa.load();
+}
+
+bool setNoiseIsa(NoiseIsa isa) {
+    if (!supported(isa)) {
+        return false;
+    }
+    g_isa.store(isa);
+    return true;
+}
+
+const char* noiseIsaName(NoiseIsa isa) {
+    switch (isa) {
+    case NOISE_SCALAR:
+        return "scalar";
+    case NOISE_SSE2:
+        return "SSE2";
+    case NOISE_AVX:
+        return "AVX";
+    }
+    return "unknown";
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// The number of samples the noise kernels evaluate per call: one row of
+// a chunk's columns
+constexpr int NOISE_BATCH = 16;
+
+// The instruction sets the kernels can run on, slowest first
+enum NoiseIsa : unsigned char {
+    NOISE_SCALAR, NOISE_SSE2, NOISE_AVX
+};
+
+// The lattice data of NOISE_BATCH Perlin noise samples, gathered by the
+// caller, one array per component so that the kernels can evaluate
+// several samples per instruction
+struct PerlinBatch {
+    // The sample point, and the lower-left corner of its cell
+    alignas(32) float px[NOISE_BATCH];
+    alignas(32) float py[NOISE_BATCH];
+    alignas(32) float cx[NOISE_BATCH];
+    alignas(32) float cy[NOISE_BATCH];
+    // The gradients at the cell's corners, indexed 2 * dx + dy
+    alignas(32) float gx[4][NOISE_BATCH];
+    alignas(32) float gy[4][NOISE_BATCH];
+};
+
+// The lattice data of NOISE_BATCH Worley noise samples
+struct WorleyBatch {
+    // The position of the sample within its cell
+    alignas(32) float fx[NOISE_BATCH];
+    alignas(32) float fy[NOISE_BATCH];
+    // The Voronoi point of each of the 3 x 3 cells around the sample's,
+    // relative to the sample's cell, indexed 3 * (y + 1) + (x + 1)
+    alignas(32) float ox[9][NOISE_BATCH];
+    alignas(32) float oy[9][NOISE_BATCH];
+};
+
+// The lattice data of NOISE_BATCH samples of 3D Perlin noise
+struct Perlin3Batch {
+    // The sample point, and the lower corner of its cell
+    alignas(32) float px[NOISE_BATCH];
+    alignas(32) float py[NOISE_BATCH];
+    alignas(32) float pz[NOISE_BATCH];
+    alignas(32) float cx[NOISE_BATCH];
+    alignas(32) float cy[NOISE_BATCH];
+    alignas(32) float cz[NOISE_BATCH];
+    // The gradients at the cell's corners, indexed 4 * dx + 2 * dy + dz
+    alignas(32) float gx[8][NOISE_BATCH];
+    alignas(32) float gy[8][NOISE_BATCH];
+    alignas(32) float gz[8][NOISE_BATCH];
+};
+
+// Quintic falloff of a surflet at distance d from its lattice point,
+// 1 - 6d^5 + 15d^4 - 10d^3, written out so that every kernel rounds it
+// the same way
+inline float perlinFalloff(float d) {
+    float d3 = d * d * d;
+    float d4 = d3 * d;
+    float d5 = d4 * d;
+    return 1.f - 6.f * d5 + 15.f * d4 - 10.f * d3;
+}
+
+// The falloff of a 3D surflet whose lattice point is (ax, ay, az) away
+// along each axis. Unlike perlinFalloff it mixes the axes, as the cave
+// noise always has, and the same value scales all three of them.
+inline float perlin3Falloff(float ax, float ay, float az) {
+    float x5 = ax * ax * ax * ax * ax;
+    float y4 = ay * ay * ay * ay;
+    float z3 = az * az * az;
+    return 1.f - 6.f * x5 + 15.f * y4 - 10.f * z3;
+}
+
+// Write the noise value of every sample in the batch to out. Every
+// instruction set gives exactly the results of the scalar kernel.
+void perlinKernel(const PerlinBatch &batch, float *out);
+void worleyKernel(const WorleyBatch &batch, float *out);
+void perlin3Kernel(const Perlin3Batch &batch, float *out);
+
+// The fastest instruction set this CPU supports, which the kernels use
+// unless told otherwise
+NoiseIsa bestNoiseIsa();
+NoiseIsa noiseIsa();
+// Makes the kernels use isa from now on. Returns false, and changes
+// nothing, if this CPU or build does not support it.
+bool setNoiseIsa(NoiseIsa isa);
+const char* noiseIsaName(NoiseIsa isa);
@@ -75,25 +75,7 @@ bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terra
 }
 
 std::string printblocktype(BlockType b) {
-    switch (b) {
-        case GRASS:
-            return "GRASS";
-        case EMPTY:
-            return "EMPTY";
-        case DIRT:
-            return "DIRT";
-        case STONE:
-            return "STONE";
-        case SNOW:
-            return "SNOW";
-        case WATER:
-            return "WATER";
-        case LAVA:
-            return "LAVA";
-        default:
-            return "unknown type";
-    }
-    return "OTHER";
+    return blockProperties(b).name;
 }
 
 void Player::processInputs(InputBundle &inputs) {
@@ -123,8 +105,6 @@ void Player::processInputs(InputBundle &inputs) {
         BlockType btype;
         bool b = gridMarch(m_camera.mcr_position, glm::normalize(m_forward) * 3.f, mcr_terrain,
                            &dist, &block, &btype);
-        int xFloor = static_cast<int>(glm::floor(block.x / 16.f));
-        int zFloor = static_cast<int>(glm::floor(block.z / 16.f));
         if (b) {
 //            std::cout << "Cam pos " << glm::to_string(m_camera.mcr_position) << std::endl;
 //            std::cout << "Look vec " << glm::to_string(glm::normalize(m_forward) * 3.f) << std::endl;
@@ -134,10 +114,7 @@ void Player::processInputs(InputBundle &inputs) {
 //            std::cout << "Coords: " << block.x << " " << block.y << " " << block.z << std::endl;
 //            std::cout << "Chunk loc: " << xFloor << " " << zFloor << ". Setting "
 //                      << block.x-xFloor*16 << " " << block.y << " " << block.z-zFloor*16 << std::endl;
-            const uPtr<Chunk>& c = mcr_terrain.getChunkAt(block.x, block.z);
-            c->setBlockAt(block.x-xFloor*16,block.y,block.z-zFloor*16,EMPTY);
-            c->destroy();
-            mcr_terrain.createVBOData(c.get());
+            mcr_terrain.setBlockAt(block.x, block.y, block.z, EMPTY);
 
             BlockType n = mcr_terrain.getBlockAt(block.x, block.y, block.z);
             std::cout << "New block type: " << printblocktype(n) << std::endl;
@@ -149,55 +126,32 @@ void Player::processInputs(InputBundle &inputs) {
         BlockType btype;
         bool b = gridMarch(m_camera.mcr_position, glm::normalize(m_forward) * 4.f, mcr_terrain,
                            &dist, &block, &btype);
-        int xFloor = static_cast<int>(glm::floor(block.x / 16.f));
-        int zFloor = static_cast<int>(glm::floor(block.z / 16.f));
         if (b) {
             glm::vec3 p = m_camera.mcr_position + glm::normalize(m_forward) * dist;
             glm::vec3 temp = p - glm::vec3(block.x, block.y, block.z);
             if (std::abs(temp.x) < .01) { //Front face place in -x direction
                 std::cout << "Place Front" << std::endl;
-                const uPtr<Chunk>& c = mcr_terrain.getChunkAt(block.x - 1, block.z);
-                c->setBlockAt(block.x-xFloor*16 - 1,block.y,block.z-zFloor*16,DIRT);
-                c->destroy();
-                mcr_terrain.createVBOData(c.get());
+                mcr_terrain.setBlockAt(block.x - 1, block.y, block.z, DIRT);
                 std::cout << "Place Front" << std::endl;
             } else if (std::abs(temp.y) < .01) { //Bottom face place in -y direction
                 std::cout << "Place Bottom" << std::endl;
-                const uPtr<Chunk>& c = mcr_terrain.getChunkAt(block.x, block.z);
-                c->setBlockAt(block.x-xFloor*16,block.y - 1,block.z-zFloor*16,DIRT);
-                c->destroy();
-                mcr_terrain.createVBOData(c.get());
+                mcr_terrain.setBlockAt(block.x, block.y - 1, block.z, DIRT);
                 std::cout << "Place Bottom" << std::endl;
             } else if (std::abs(temp.z) < .01) { //Left face place in -z direction
                 std::cout << "Place Left" << std::endl;
-                const uPtr<Chunk>& c = mcr_terrain.getChunkAt(block.x, block.z - 1);
-                c->setBlockAt(block.x-xFloor*16,block.y,block.z-zFloor*16 - 1,DIRT);
-                c->destroy();
-                mcr_terrain.createVBOData(c.get());
+                mcr_terrain.setBlockAt(block.x, block.y, block.z - 1, DIRT);
                 std::cout << "Place Left" << std::endl;
             } else if (std::abs(temp.x - 1.f) < .01) { //Back face place in x direction
                 std::cout << "Place Back" << std::endl;
-                const uPtr<Chunk>& c = mcr_terrain.getChunkAt(block.x + 1, block.z);
-                c->setBlockAt(block.x-xFloor*16 + 1,block.y,block.z-zFloor*16,DIRT);
-                c->destroy();
-                mcr_terrain.createVBOData(c.get());
+                mcr_terrain.setBlockAt(block.x + 1, block.y, block.z, DIRT);
                 std::cout << "Place Back" << std::endl;
             } else if (std::abs(temp.y - 1.f) < .01) { //Top face place in y direction
                 std::cout << "Place Top" << std::endl;
-                const uPtr<Chunk>& c = mcr_terrain.getChunkAt(block.x, block.z);
-                c->setBlockAt(block.x-xFloor*16,block.y + 1,block.z-zFloor*16,DIRT);
-                c->destroy();
-                mcr_terrain.createVBOData(c.get());
+                mcr_terrain.setBlockAt(block.x, block.y + 1, block.z, DIRT);
                 std::cout << "Place Top" << std::endl;
             } else if (std::abs(temp.z - 1.f) < .01) { //Right face place in z direction
-                const uPtr<Chunk>& c = mcr_terrain.getChunkAt(block.x, block.z + 1);
-                c->setBlockAt(block.x,block.y,block.z + 1,DIRT);
-                c->destroy();
-                mcr_terrain.createVBOData(c.get());
+                mcr_terrain.setBlockAt(block.x, block.y, block.z + 1, DIRT);
                 std::cout << "Place Right" << std::endl;
-                c->setBlockAt(block.x-xFloor*16,block.y,block.z-zFloor*16 + 1,DIRT);
-                c->destroy();
-                mcr_terrain.createVBOData(c.get());
             }
         }
         inputs.rightClick = false;
@@ -258,7 +212,7 @@ void Player::computePhysics(float dT, const Terrain &terrain, bool jumped) {
         glm::vec3 belowCorner = corners[i] - glm::vec3(0, 0.1f, 0);
         BlockType belowMe = terrain.getBlockAt(belowCorner);
 
-        if (!flight && belowMe != WATER && belowMe != LAVA && belowMe != EMPTY) {
+        if (!flight && blockProperties(belowMe).collides) {
             m_isGrounded = true;
             m_velocity.y = 0.f;
             break;
@@ -267,7 +221,7 @@ void Player::computePhysics(float dT, const Terrain &terrain, bool jumped) {
 
     bool swimming = false; //in water?
     BlockType feetBlock = terrain.getBlockAt(m_position);
-    if (feetBlock == WATER || feetBlock == LAVA) {
+    if (blockProperties(feetBlock).liquid) {
         swimming = true;
     }
     if (!flight) {
@@ -319,17 +273,17 @@ void Player::computePhysics(float dT, const Terrain &terrain, bool jumped) {
             gridMarch(c, glm::vec3(direction.x, 0.f, 0.f), terrain, &x, &blockx, &bx);
             gridMarch(c, glm::vec3(0.f, direction.y, 0.f), terrain, &y, &blocky, &by);
             gridMarch(c, glm::vec3(0.f, 0.f, direction.z), terrain, &z, &blockz, &bz);
-            if (bx != WATER && bx != LAVA && x < minDist.x) {
+            if (blockProperties(bx).collides && x < minDist.x) {
     //            std::cout << "X block" << std::endl;
                 minDist.x = x;
                 m_velocity.x = 0.f;
             }
-            if (by != WATER && by != LAVA && y < minDist.y) {
+            if (blockProperties(by).collides && y < minDist.y) {
     //            std::cout << "Y block" << std::endl;
                 minDist.y = y;
                 m_velocity.y = 0.f;
             }
-            if (bz != WATER && bz != LAVA && z < minDist.z) {
+            if (blockProperties(bz).collides && z < minDist.z) {
     //            std::cout << "Z block" << std::endl;
                 minDist.z = z;
                 m_velocity.z = 0.f;
@@ -358,7 +312,7 @@ void Player::computePhysics(float dT, const Terrain &terrain, bool jumped) {
 
 void Player::checkSubmerge(const Terrain &terrain) {
     BlockType btype = terrain.getBlockAt(mcr_camera.mcr_position);
-    if (btype == LAVA || btype == WATER) {
+    if (blockProperties(btype).liquid) {
         submerge = btype;
     } else {
         submerge = EMPTY;
@@ -1,17 +1,36 @@
 #include "terrain.h"
+#include <QThread>
 #include <stdexcept>
+#include <algorithm>
 #include <iostream>
 
-Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), mp_context(context)
-{}
+// Room in each queue that hands worker results to the main thread
+static const size_t RESULT_QUEUE_CAPACITY = 1024;
+
+Terrain::Terrain(OpenGLContext *context, CaveMode caves, uint64_t seed)
+    : m_chunks(), m_grid(), m_generatedTerrain(), m_zoneChunksLeft(), m_requestedZones(),
+      m_droppedGenerations(), m_generateTasks(), m_meshTasks(), m_wantedZones(),
+      m_zoneRequestedAt(), m_firstVisibleTotal(0), m_firstVisibleMax(0), m_firstVisibleCount(0),
+      m_meshBuffers(),
+      m_chunksWithBlockData(RESULT_QUEUE_CAPACITY),
+      m_meshesToUpload(), m_uploadBudgetMs(2.f), m_uploadBudgetBytes(1 << 20), m_uploadStats(),
+      m_pendingRemeshes(),
+      m_clock(), m_remeshLatencyTotal(0), m_remeshLatencyMax(0), m_remeshCount(0),
+      m_meshMode(PER_FACE), m_meshStats(), m_caveMode(caves), m_heightMap(mkU<HeightMap>(seed)), m_bufQuadIdx(), m_quadIdxCapacity(0),
+      m_tryExpansionTimer(0.f), m_initialSceneLoaded(false), mp_context(context),
+      m_jobs(QThread::idealThreadCount(), RESULT_QUEUE_CAPACITY), m_scheduler(m_jobs)
+{
+    m_clock.start();
+}
 
 Terrain::~Terrain() {
-    for (auto& chunk : m_chunks) {
-        Chunk* c = chunk.second.get();
+    m_chunks.forEach([](Chunk *c) {
         if(c->mcr_VBOcreated) {
             c->destroy();
         }
+    });
+    if (m_quadIdxCapacity > 0) {
+        mp_context->glDeleteBuffers(1, &m_bufQuadIdx);
     }
 }
 
@@ -33,6 +52,11 @@ int64_t Terrain::toKey(int x, int z) {
     return xz;
 }
 
+int64_t Terrain::zoneOf(int x, int z) {
+    return toKey(static_cast<int>(glm::floor(x / 64.f)) * 64,
+                 static_cast<int>(glm::floor(z / 64.f)) * 64);
+}
+
 glm::ivec2 toCoords(int64_t k) {
     // Z is lower 32 bits
     int64_t z = k & 0x00000000ffffffff;
@@ -51,17 +75,23 @@ glm::ivec2 toCoords(int64_t k) {
 // the coordinates at x, y, z have a corresponding Chunk
 BlockType Terrain::getBlockAt(int x, int y, int z) const
 {
-    if(hasChunkAt(x, z)) {
+    const Chunk *c = loadedChunkAt(x, z);
+    if(c != nullptr) {
         // Just disallow action below or above min/max height,
         // but don't crash the game over it.
         if(y < 0 || y >= 256) {
             return EMPTY;
         }
-        const uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        return c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
+        // Rays and falling players mostly pass through the air above the
+        // surface, which needs no section lookup. A chunk still generating
+        // reads as air, since its sections may be repacked at any time.
+        if(y > c->topBlockY(static_cast<unsigned int>(x - c->mcr_origin.x),
+                            static_cast<unsigned int>(z - c->mcr_origin.y))) {
+            return EMPTY;
+        }
+        return c->getBlockAt(static_cast<unsigned int>(x - c->mcr_origin.x),
                              static_cast<unsigned int>(y),
-                             static_cast<unsigned int>(z - chunkOrigin.y));
+                             static_cast<unsigned int>(z - c->mcr_origin.y));
     }
     else {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
@@ -80,7 +110,33 @@ BlockType Terrain::getBlockAt(glm::vec3 p) const {
     return getBlockAt(blockpos.x, blockpos.y, blockpos.z);
 }
 
+int Terrain::surfaceHeight(int x, int z) const {
+    const Chunk *c = loadedChunkAt(x, z);
+    if (c == nullptr) {
+        throw std::out_of_range("Coordinates " + std::to_string(x) + " " +
+                                std::to_string(z) + " have no Chunk!");
+    }
+    return c->topBlockY(static_cast<unsigned int>(x - c->mcr_origin.x),
+                        static_cast<unsigned int>(z - c->mcr_origin.y));
+}
+
+std::pair<int, Biome> Terrain::groundAt(int x, int z) const {
+    const Chunk *c = loadedChunkAt(x, z);
+    if (c == nullptr || !c->blocksFilled()) {
+        return m_heightMap->getHeight(x, z);
+    }
+    const HeightTile &ground = c->ground();
+    int xl = x - c->mcr_origin.x;
+    int zl = z - c->mcr_origin.y;
+    return {ground.height(xl, zl), ground.biome(xl, zl)};
+}
+
 bool Terrain::hasChunkAt(int x, int z) const {
+    return loadedChunkAt(x, z) != nullptr;
+}
+
+
+Chunk* Terrain::getChunkAt(int x, int z) const {
     // Map x and z to their nearest Chunk corner
     // By flooring x and z, then multiplying by 16,
     // we clamp (x, z) to its nearest Chunk-space corner,
@@ -90,32 +146,30 @@ bool Terrain::hasChunkAt(int x, int z) const {
     // opposed to (int)(-1 / 16.f) giving us 0 (incorrect!).
     int xFloor = static_cast<int>(glm::floor(x / 16.f));
     int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor)) != m_chunks.end();
+    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor));
 }
 
-
-uPtr<Chunk>& Terrain::getChunkAt(int x, int z) {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks[toKey(16 * xFloor, 16 * zFloor)];
-}
-
-
-const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
+Chunk* Terrain::loadedChunkAt(int x, int z) const {
+    // Like floor(x / 16.f), an arithmetic shift rounds negative
+    // coordinates down
+    int cx = x >> 4;
+    int cz = z >> 4;
+    if (m_grid.contains(cx, cz)) {
+        return m_grid.at(cx, cz);
+    }
+    return m_chunks.find(toKey(16 * cx, 16 * cz));
 }
 
 void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 {
-    if(hasChunkAt(x, z)) {
-        uPtr<Chunk> &c = getChunkAt(x, z);
+    Chunk *c = loadedChunkAt(x, z);
+    if(c != nullptr) {
         glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
         c->setBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
                       static_cast<unsigned int>(y),
                       static_cast<unsigned int>(z - chunkOrigin.y),
                       t);
+        markDirty(c, x - chunkOrigin.x, z - chunkOrigin.y);
     }
     else {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
@@ -124,91 +178,181 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
     }
 }
 
-Chunk* Terrain::instantiateChunkAt(int x, int z) {
-    uPtr<Chunk> chunk = mkU<Chunk>(mp_context);
-    Chunk *cPtr = chunk.get();
-    m_chunks[toKey(x, z)] = move(chunk);
-    // Set the neighbor pointers of itself and its neighbors
-    if(hasChunkAt(x, z + 16)) {
-        auto &chunkNorth = m_chunks[toKey(x, z + 16)];
-        cPtr->linkNeighbor(chunkNorth, ZPOS);
-    }
-    if(hasChunkAt(x, z - 16)) {
-        auto &chunkSouth = m_chunks[toKey(x, z - 16)];
-        cPtr->linkNeighbor(chunkSouth, ZNEG);
-    }
-    if(hasChunkAt(x + 16, z)) {
-        auto &chunkEast = m_chunks[toKey(x + 16, z)];
-        cPtr->linkNeighbor(chunkEast, XPOS);
+void Terrain::markDirty(Chunk *c, int x, int z) {
+    m_dirtyChunks.insert(c);
+    // A block on the chunk's edge is also the neighbour's boundary block
+    Chunk *neighbors[4] = {
+        x == 0 ? c->mcr_neighbors.at(XNEG) : nullptr,
+        x == 15 ? c->mcr_neighbors.at(XPOS) : nullptr,
+        z == 0 ? c->mcr_neighbors.at(ZNEG) : nullptr,
+        z == 15 ? c->mcr_neighbors.at(ZPOS) : nullptr,
+    };
+    for (Chunk *n : neighbors) {
+        if (n != nullptr) {
+            m_dirtyChunks.insert(n);
+        }
     }
-    if(hasChunkAt(x - 16, z)) {
-        auto &chunkWest = m_chunks[toKey(x - 16, z)];
-        cPtr->linkNeighbor(chunkWest, XNEG);
+}
+
+void Terrain::remeshDirtyChunks() {
+    for (Chunk *c : m_dirtyChunks) {
+        // A chunk still being generated is meshed once it is done
+        if (c->blocksFilled()) {
+            remeshChunk(c);
+        }
     }
+    m_dirtyChunks.clear();
+}
+
+Chunk* Terrain::instantiateChunkAt(int x, int z) {
+    Chunk *cPtr = m_chunks.insert(toKey(x, z), mkU<Chunk>(mp_context, glm::ivec2(x, z)));
+    m_grid.set(x >> 4, z >> 4, cPtr);
+    // Set the neighbor pointers of itself and its neighbors
+    cPtr->linkNeighbor(m_chunks.find(toKey(x, z + 16)), ZPOS);
+    cPtr->linkNeighbor(m_chunks.find(toKey(x, z - 16)), ZNEG);
+    cPtr->linkNeighbor(m_chunks.find(toKey(x + 16, z)), XPOS);
+    cPtr->linkNeighbor(m_chunks.find(toKey(x - 16, z)), XNEG);
     return cPtr;
 }
 
 
 void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram) {
-    for(int x = minX; x <= maxX; x += 16) {
-        for(int z = minZ; z <= maxZ; z += 16) {
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-            if (chunk.get() == nullptr || !chunk->mcr_VBOcreated) {
-                continue;
-            }
-            shaderProgram->setModelMatrix(glm::translate(glm::mat4(1.f), glm::vec3(x, 0.f, z)));
-            shaderProgram->drawInterleaved(*chunk);
-        }
-    }
-    for(int x = minX; x <= maxX; x += 16) {
-        for(int z = minZ; z <= maxZ; z += 16) {
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-            if (chunk.get() == nullptr || !chunk->mcr_VBOcreated) {
-                continue;
-            }
-            shaderProgram->setModelMatrix(glm::translate(glm::mat4(1.f), glm::vec3(x, 0.f, z)));
-            shaderProgram->drawInterleavedTransparent(*chunk);
+    drawOpaque(minX, maxX, minZ, maxZ, shaderProgram);
+    m_grid.forEach([&](Chunk *chunk) {
+        const glm::ivec2 &o = chunk->mcr_origin;
+        if (o.x < minX || o.x > maxX || o.y < minZ || o.y > maxZ || !chunk->mcr_VBOcreated) {
+            return;
         }
-    }
+        shaderProgram->setModelMatrix(glm::translate(glm::mat4(1.f), glm::vec3(o.x, 0.f, o.y)));
+        shaderProgram->drawInterleavedTransparent(*chunk, m_bufQuadIdx);
+    });
 }
 
 void Terrain::drawOpaque(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram) {
-    for(int x = minX; x <= maxX; x += 16) {
-        for(int z = minZ; z <= maxZ; z += 16) {
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-            if (chunk.get() == nullptr || !chunk->mcr_VBOcreated) {
-                continue;
-            }
-            shaderProgram->setModelMatrix(glm::translate(glm::mat4(1.f), glm::vec3(x, 0.f, z)));
-            shaderProgram->drawInterleaved(*chunk);
+    m_grid.forEach([&](Chunk *chunk) {
+        const glm::ivec2 &o = chunk->mcr_origin;
+        if (o.x < minX || o.x > maxX || o.y < minZ || o.y > maxZ || !chunk->mcr_VBOcreated) {
+            return;
+        }
+        shaderProgram->setModelMatrix(glm::translate(glm::mat4(1.f), glm::vec3(o.x, 0.f, o.y)));
+        shaderProgram->drawInterleaved(*chunk, m_bufQuadIdx);
+    });
+}
+
+void Terrain::waitForJobs() {
+    m_jobs.waitForDone();
+}
+
+sPtr<Task> Terrain::makeMeshTask(Chunk *c, bool remesh) {
+    c->bumpGeneration();
+    // Filled by the mesh task and read by the upload task, which holds it
+    sPtr<uPtr<ChunkVBOData>> mesh = mkS<uPtr<ChunkVBOData>>();
+    sPtr<Task> meshTask = mkS<Task>(new VBOWorker(c, *mesh, m_meshBuffers, m_meshMode),
+                                    remesh ? URGENT_LANE : WORKER_LANE);
+    sPtr<Task> upload = mkS<Task>(QRunnable::create([this, mesh, remesh]() {
+        // Empty if the chunk's generation was dropped
+        if (*mesh == nullptr) {
+            return;
+        }
+        if (remesh) {
+            uploadRemesh(std::move(*mesh));
+        } else {
+            Chunk *meshed = (*mesh)->mp_chunk;
+            m_meshesToUpload[meshed] = std::move(*mesh);
         }
+    }), MAIN_LANE);
+    m_jobs.addDependency(meshTask, upload);
+    m_jobs.submit(upload);
+
+    auto waitOn = [&](Chunk *n) {
+        auto it = m_generateTasks.find(n);
+        if (it != m_generateTasks.end()) {
+            m_jobs.addDependency(it->second, meshTask);
+        }
+    };
+    waitOn(c);
+    for (const auto &kv : c->mcr_neighbors) {
+        waitOn(kv.second);
+    }
+    m_meshTasks[c] = meshTask;
+    return meshTask;
+}
+
+void Terrain::meshChunk(Chunk *c) {
+    int64_t zone = zoneOf(c->mcr_origin.x, c->mcr_origin.y);
+    // Meshed when the player comes back to it
+    if (!m_wantedZones.contains(zone)) {
+        return;
     }
+    m_scheduler.enqueue(makeMeshTask(c, false), MESH, c, zone,
+                        glm::vec2(c->mcr_origin) + glm::vec2(8.f));
 }
 
-void Terrain::spawnVBOWorker(Chunk* c) {
-    VBOWorker* w = new VBOWorker(c, m_chunksWithVBOData,
-                                 &m_chunksWithVBODataMux);
-    QThreadPool::globalInstance()->start(w);
+void Terrain::meshNeighborsAfter(Chunk *c, const sPtr<Task> &generate) {
+    for (const auto &kv : c->mcr_neighbors) {
+        Chunk *n = kv.second;
+        if (n == nullptr || !m_wantedZones.contains(zoneOf(n->mcr_origin.x, n->mcr_origin.y))) {
+            continue;
+        }
+        auto it = m_meshTasks.find(n);
+        if (it != m_meshTasks.end() && m_jobs.addDependency(generate, it->second)) {
+            continue;
+        }
+        // Only happens at the edge of the wanted zones: n was meshed while
+        // c was outside them. An n without blocks gets a mesh task that
+        // waits on c along with its own generation.
+        if (!n->blocksFilled()) {
+            continue;
+        }
+        if (m_pendingRemeshes.count(n)) {
+            // n's edits wait on a remesh, which must also see c
+            remeshChunk(n);
+        } else {
+            meshChunk(n);
+        }
+    }
 }
 
 void Terrain::spawnBlockTypeWorker(int64_t id) {
     ivec2 coords = toCoords(id);
+    std::vector<Chunk*> toGenerate;
+    int newChunks = 0;
     for (int x = coords.x; x < coords.x + 64; x += 16) {
         for (int z = coords.y; z < coords.y + 64; z += 16) {
-            uPtr<Chunk> chunk = mkU<Chunk>(mp_context);
-            instantiateChunkAt(x,z);
+            Chunk *c = getChunkAt(x, z);
+            if (c == nullptr) {
+                toGenerate.push_back(instantiateChunkAt(x, z));
+                newChunks++;
+            }
+            // Left over if an earlier request for this zone was dropped;
+            // chunks generated or being generated since are left alone
+            else if (m_droppedGenerations.erase(c)) {
+                toGenerate.push_back(c);
+            }
         }
     }
-    BlockTypeWorker* w = new BlockTypeWorker(this, m_generatedTerrain, &m_genTerrainMux,
-                                             m_chunksWithBlockData, &m_chunksWithBlockDataMux,
-                                             ivec2(coords.x, coords.y));
-    QThreadPool::globalInstance()->start(w);
-}
+    m_genTerrainMux.lock();
+    m_zoneChunksLeft[id] += newChunks;
+    m_genTerrainMux.unlock();
 
-void Terrain::spawnVBOWorkers(const std::unordered_set<Chunk*> &chunks) {
-    for (Chunk *c : chunks) {
-        spawnVBOWorker(c);
+    for (Chunk *c : toGenerate) {
+        sPtr<Task> generate = mkS<Task>(new BlockTypeWorker(c, m_generatedTerrain, m_zoneChunksLeft,
+                                                            &m_genTerrainMux, m_chunksWithBlockData,
+                                                            *m_heightMap, m_caveMode),
+                                        WORKER_LANE);
+        m_generateTasks[c] = generate;
+        m_scheduler.enqueue(generate, GENERATE, c, id, glm::vec2(c->mcr_origin) + glm::vec2(8.f));
+    }
+    // Once every chunk of the zone has its generation task, so that each
+    // mesh task waits on the neighbors in the zone too
+    for (Chunk *c : toGenerate) {
+        meshNeighborsAfter(c, m_generateTasks[c]);
+    }
+    for (Chunk *c : toGenerate) {
+        meshChunk(c);
     }
+    m_requestedZones.insert(id);
+    m_zoneRequestedAt[id] = m_clock.elapsed();
 }
 
 void Terrain::spawnBTWorkers(const std::unordered_set<int64_t> &ids) {
@@ -217,19 +361,228 @@ void Terrain::spawnBTWorkers(const std::unordered_set<int64_t> &ids) {
     }
 }
 
-void Terrain::checkThreadResults() {
-    m_chunksWithBlockDataMux.lock();
-    spawnVBOWorkers(m_chunksWithBlockData);
-    m_chunksWithBlockData.clear();
-    m_chunksWithBlockDataMux.unlock();
+void Terrain::checkThreadResults(glm::vec3 pos) {
+    Chunk *generated;
+    while (m_chunksWithBlockData.tryPop(generated)) {
+        m_generateTasks.erase(generated);
+    }
+    m_jobs.runMainTasks();
+    uploadMeshes(pos);
+}
+
+void Terrain::uploadMeshes(glm::vec3 pos) {
+    if (m_meshesToUpload.empty()) {
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<Chunk*> order;
+    order.reserve(m_meshesToUpload.size());
+    for (auto it = m_meshesToUpload.begin(); it != m_meshesToUpload.end();) {
+        Chunk *c = it->first;
+        const glm::ivec2 &origin = c->mcr_origin;
+        // The chunk changed since this mesh was started, a remesh started
+        // no earlier will carry the same blocks, or the player left the
+        // zone while the chunk was being meshed or waiting here
+        auto pending = m_pendingRemeshes.find(c);
+        if (it->second->m_generation != c->generation()
+                || (pending != m_pendingRemeshes.end()
+                    && pending->second.generation >= it->second->m_generation)
+                || !m_wantedZones.contains(zoneOf(origin.x, origin.y))) {
+            it = m_meshesToUpload.erase(it);
+            continue;
+        }
+        order.push_back(c);
+        ++it;
+    }
+    glm::vec2 pos2(pos.x, pos.z);
+    auto dist2 = [&](Chunk *c) {
+        glm::vec2 d = glm::vec2(c->mcr_origin) + glm::vec2(8.f) - pos2;
+        return glm::dot(d, d);
+    };
+    std::sort(order.begin(), order.end(), [&](Chunk *a, Chunk *b) {
+        return dist2(a) < dist2(b);
+    });
+
+    qint64 budgetNs = static_cast<qint64>(m_uploadBudgetMs * 1000000.f);
+    size_t bytes = 0;
+    int uploaded = 0;
+    for (Chunk *c : order) {
+        if (uploaded > 0 && (timer.nsecsElapsed() >= budgetNs || bytes >= m_uploadBudgetBytes)) {
+            break;
+        }
+        uPtr<ChunkVBOData> &d = m_meshesToUpload[c];
+        bytes += (d->m_vboDataOpaque.size() + d->m_vboDataTransparent.size()) * sizeof(ChunkVertex);
+        uploadVBOData(*d);
+        m_meshesToUpload.erase(c);
+        // Started after the chunk's last remesh, so it holds the edits too
+        editsVisible(c);
+        uploaded++;
+    }
+
+    if (uploaded == 0) {
+        return;
+    }
+    qint64 us = timer.nsecsElapsed() / 1000;
+    m_uploadStats.frames++;
+    m_uploadStats.chunks += uploaded;
+    m_uploadStats.bytes += bytes;
+    m_uploadStats.lastFrame = us;
+    m_uploadStats.maxFrame = std::max(m_uploadStats.maxFrame, us);
+    m_uploadStats.total += us;
+}
+
+void Terrain::setUploadBudget(float ms, size_t bytes) {
+    m_uploadBudgetMs = ms;
+    m_uploadBudgetBytes = bytes;
+}
 
-    m_chunksWithVBODataMux.lock();
-    for (uPtr<ChunkVBOData>& c : m_chunksWithVBOData) {
-        c->mp_chunk->createVBOdata(c->m_idxDataOpaque, c->m_vboDataOpaque);
-        c->mp_chunk->createVBOdataTransparent(c->m_idxDataTransparent, c->m_vboDataTransparent);
+float Terrain::uploadBudgetMs() const {
+    return m_uploadBudgetMs;
+}
+
+size_t Terrain::uploadBudgetBytes() const {
+    return m_uploadBudgetBytes;
+}
+
+void Terrain::printUploadStats() const {
+    const UploadStats &s = m_uploadStats;
+    if (s.frames == 0) {
+        return;
+    }
+    std::cout << "mesh uploads: " << s.chunks << " chunks, " << s.bytes / 1024
+              << " KB over " << s.frames << " frames, " << s.total / s.frames / 1000.f
+              << " ms avg, " << s.maxFrame / 1000.f << " ms max, "
+              << s.lastFrame / 1000.f << " ms last (budget " << m_uploadBudgetMs
+              << " ms, " << m_uploadBudgetBytes / 1024 << " KB)" << std::endl;
+    if (m_firstVisibleCount > 0) {
+        std::cout << "zones: " << m_firstVisibleCount << " shown, first chunk visible after "
+                  << m_firstVisibleTotal / m_firstVisibleCount << " ms avg, "
+                  << m_firstVisibleMax << " ms max" << std::endl;
+    }
+}
+
+void Terrain::printChunkStates() const {
+    const char *names[7] = {"allocated", "generating", "generated", "meshing",
+                            "mesh ready", "uploaded", "evicted"};
+    std::array<int, 7> counts = {};
+    m_chunks.forEach([&](Chunk *c) {
+        counts[c->state()]++;
+    });
+    std::cout << "chunk states:";
+    for (int i = 0; i < 7; i++) {
+        std::cout << " " << names[i] << " " << counts[i] << (i < 6 ? "," : "");
+    }
+    std::cout << std::endl;
+}
+
+void Terrain::uploadVBOData(ChunkVBOData &c) {
+    reserveQuadIndices(std::max(c.m_vboDataOpaque.size(), c.m_vboDataTransparent.size()) / 4);
+    c.mp_chunk->createVBOdata(c.m_vboDataOpaque);
+    c.mp_chunk->createVBOdataTransparent(c.m_vboDataTransparent);
+    c.mp_chunk->setLastMeshVertices(c.m_vboDataOpaque.size(), c.m_vboDataTransparent.size());
+    // Stays MESHING if a newer job has started on the chunk since
+    c.mp_chunk->transition(MESH_READY, UPLOADED);
+
+    MeshStats &stats = m_meshStats[c.m_mode];
+    size_t vertices = c.m_vboDataOpaque.size() + c.m_vboDataTransparent.size();
+    stats.chunks++;
+    stats.vertices += vertices;
+    stats.indices += vertices / 4 * 6;
+
+    const glm::ivec2 &origin = c.mp_chunk->mcr_origin;
+    auto it = m_zoneRequestedAt.find(zoneOf(origin.x, origin.y));
+    if (it != m_zoneRequestedAt.end()) {
+        qint64 latency = m_clock.elapsed() - it->second;
+        m_firstVisibleTotal += latency;
+        m_firstVisibleMax = std::max(m_firstVisibleMax, latency);
+        m_firstVisibleCount++;
+        m_zoneRequestedAt.erase(it);
+    }
+}
+
+void Terrain::reserveQuadIndices(int quads) {
+    if (quads <= m_quadIdxCapacity) {
+        return;
+    }
+    int capacity = std::max(m_quadIdxCapacity, 4096);
+    while (capacity < quads) {
+        capacity *= 2;
+    }
+
+    // Same winding as Chunk::createVBOdataFace lays its four vertices out in
+    std::vector<GLuint> idx;
+    idx.reserve(capacity * 6);
+    for (GLuint i = 0; i < GLuint(capacity) * 4; i += 4) {
+        idx.push_back(i);
+        idx.push_back(i+1);
+        idx.push_back(i+3);
+        idx.push_back(i+2);
+        idx.push_back(i+3);
+        idx.push_back(i+1);
+    }
+
+    if (m_quadIdxCapacity == 0) {
+        mp_context->glGenBuffers(1, &m_bufQuadIdx);
+    }
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufQuadIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint),
+                             idx.data(), GL_STATIC_DRAW);
+    m_quadIdxCapacity = capacity;
+}
+
+void Terrain::setMeshMode(MeshMode mode) {
+    m_meshMode = mode;
+    m_chunks.forEach([&](Chunk *c) {
+        if (m_pendingRemeshes.count(c)) {
+            // Remeshed with the new mesher instead, so that its edits
+            // still wait on a remesh that uploadRemesh will show
+            remeshChunk(c);
+        } else if (c->mcr_VBOcreated) {
+            // Meshes from the old mesher still in flight are dropped. The
+            // new mesh replaces the old one's buffers when it is uploaded.
+            meshChunk(c);
+        }
+    });
+}
+
+MeshMode Terrain::meshMode() const {
+    return m_meshMode;
+}
+
+CaveMode Terrain::caveMode() const {
+    return m_caveMode;
+}
+
+uint64_t Terrain::seed() const {
+    return m_heightMap->seed();
+}
+
+void Terrain::printMeshStats() const {
+    const char *names[2] = {"per-face", "greedy"};
+    for (int i = 0; i < 2; i++) {
+        const MeshStats &s = m_meshStats[i];
+        if (s.chunks == 0) {
+            continue;
+        }
+        size_t bytes = s.vertices * sizeof(ChunkVertex);
+        std::cout << names[i] << " mesher: " << s.chunks << " chunks, "
+                  << s.vertices << " vertices ("
+                  << s.vertices / s.chunks << " per chunk), "
+                  << s.indices << " indices ("
+                  << s.indices / s.chunks << " per chunk), "
+                  << bytes / 1024 << " KB uploaded" << std::endl;
+    }
+    std::cout << "shared quad index buffer: " << m_quadIdxCapacity << " quads, "
+              << m_quadIdxCapacity * 6 * sizeof(GLuint) / 1024 << " KB" << std::endl;
+    std::cout << "mesh buffer pool: " << m_meshBuffers.pooledCount() << " free buffers, "
+              << m_meshBuffers.pooledCapacity() * sizeof(ChunkVertex) / 1024 << " KB" << std::endl;
+    if (m_remeshCount > 0) {
+        std::cout << "edits: " << m_remeshCount << " remeshes, visible after "
+                  << m_remeshLatencyTotal / m_remeshCount << " ms avg, "
+                  << m_remeshLatencyMax << " ms max" << std::endl;
     }
-    m_chunksWithVBOData.clear();
-    m_chunksWithVBODataMux.unlock();
 }
 
 QSet<int64_t> Terrain::zonesBorderingZone(ivec2 zonePos, int radius) {
@@ -250,69 +603,126 @@ boolean Terrain::terrainZoneExists(int64_t id) {
     return ret;
 }
 
-void Terrain::tryExpansion(vec3 pos, vec3 posPrev) {
+void Terrain::tryExpansion(vec3 pos) {
     ivec2 currZone(floor(pos[0] / 64.f) * 64.f, floor(pos[2] / 64.f) * 64.f);
-    ivec2 prevZone(floor(posPrev[0] / 64.f) * 64.f, floor(posPrev[2] / 64.f) * 64.f);
-
     QSet<int64_t> currBorderingZones = zonesBorderingZone(currZone, 2);
-    QSet<int64_t> prevBorderingZones = zonesBorderingZone(prevZone, 2);
+    if (currBorderingZones == m_wantedZones) {
+        return;
+    }
+    QSet<int64_t> prevBorderingZones = m_wantedZones;
+    m_wantedZones = currBorderingZones;
 
     for (auto id : prevBorderingZones) {
         if (!currBorderingZones.contains(id)) {
             ivec2 coord = toCoords(id);
             for (int x = coord.x; x < coord.x + 64; x += 16) {
                 for (int z = coord.y; z < coord.y + 64; z += 16) {
-                    auto &chunk = getChunkAt(x,z);
+                    Chunk *chunk = getChunkAt(x, z);
                     chunk->destroy();
+                    chunk->advance(EVICTED);
                 }
             }
         }
     }
 
+    // Chunks whose generation never started are scheduled again if the
+    // player comes back to their zone. Chunks still wanted whose mesh
+    // waited on them are meshed without them.
+    for (Chunk *c : m_scheduler.dropUnwanted(currBorderingZones)) {
+        int64_t id = zoneOf(c->mcr_origin.x, c->mcr_origin.y);
+        m_droppedGenerations.insert(c);
+        m_generateTasks.erase(c);
+        m_requestedZones.erase(id);
+        m_zoneRequestedAt.erase(id);
+    }
+
     for (auto id : currBorderingZones) {
-        if (terrainZoneExists(id)) {
-            if (!prevBorderingZones.contains(id)) {
-                ivec2 coords = toCoords(id);
-                for (int x = coords.x; x < coords.x + 64; x += 16) {
-                    for (int z = coords.y; z < coords.y + 64; z += 16) {
-                        auto &chunk = getChunkAt(x,z);
-                        spawnVBOWorker(chunk.get());
+        // Chunks generated while the player was away from their zone were
+        // not meshed, even if the rest of the zone is still generating
+        if (!prevBorderingZones.contains(id)) {
+            ivec2 coords = toCoords(id);
+            for (int x = coords.x; x < coords.x + 64; x += 16) {
+                for (int z = coords.y; z < coords.y + 64; z += 16) {
+                    Chunk *chunk = getChunkAt(x, z);
+                    if (chunk != nullptr && chunk->blocksFilled()) {
+                        meshChunk(chunk);
                     }
                 }
             }
         }
-        else {
+        if (!terrainZoneExists(id) && m_requestedZones.count(id) == 0) {
             spawnBlockTypeWorker(id);
         }
     }
 }
 
-void Terrain::multiThreadedWork(glm::vec3 pos, glm::vec3 posPrev, float dT) {
+void Terrain::multiThreadedWork(glm::vec3 pos, glm::vec3 forward, float dT) {
+    m_grid.recenter(static_cast<int>(glm::floor(pos.x / 16.f)),
+                    static_cast<int>(glm::floor(pos.z / 16.f)), m_chunks);
+    remeshDirtyChunks();
+    checkThreadResults(pos);
+    m_scheduler.dispatch(pos, forward);
     m_tryExpansionTimer += dT;
 
     if (m_tryExpansionTimer < 0.5f) {
         return;
     }
 
-    tryExpansion(pos, posPrev);
-    checkThreadResults();
+    tryExpansion(pos);
     m_tryExpansionTimer = 0.f;
 }
 
-void Terrain::createVBOData(Chunk *c) {
-    m_chunksWithBlockDataMux.lock();
-    spawnVBOWorker(c);
-    m_chunksWithBlockData.clear();
-    m_chunksWithBlockDataMux.unlock();
-    QThreadPool::globalInstance()->waitForDone();
+void Terrain::remeshChunk(Chunk *c) {
+    sPtr<Task> t = makeMeshTask(c, true);
+    // Keeps the time of the earliest edit still waiting
+    auto it = m_pendingRemeshes.find(c);
+    if (it == m_pendingRemeshes.end()) {
+        m_pendingRemeshes.insert({c, PendingRemesh{m_clock.elapsed(), c->generation()}});
+    } else {
+        it->second.generation = c->generation();
+    }
+
+    m_jobs.submit(t);
+}
+
+void Terrain::uploadRemesh(uPtr<ChunkVBOData> c) {
+    auto it = m_pendingRemeshes.find(c->mp_chunk);
+    if (it == m_pendingRemeshes.end()) {
+        return;
+    }
+    const glm::ivec2 &origin = c->mp_chunk->mcr_origin;
+    if (!m_wantedZones.contains(zoneOf(origin.x, origin.y))
+            || c->mp_chunk->state() == EVICTED) {
+        // The zone left the view while the remesh ran. The bulk mesh
+        // made when it comes back holds the edits, and must not wait
+        // on this remesh.
+        m_pendingRemeshes.erase(it);
+        return;
+    }
+    if (c->m_generation != c->mp_chunk->generation()) {
+        // Made stale by something other than a later edit, such as the
+        // zone coming back into view, which started a bulk mesh that
+        // holds the edits
+        if (it->second.generation == c->m_generation) {
+            m_pendingRemeshes.erase(it);
+        }
+        return;
+    }
+    uploadVBOData(*c);
+    editsVisible(c->mp_chunk);
+}
 
-    m_chunksWithVBODataMux.lock();
-    for (uPtr<ChunkVBOData>& c : m_chunksWithVBOData) {
-        c->mp_chunk->createVBOdata(c->m_idxDataOpaque, c->m_vboDataOpaque);
-        c->mp_chunk->createVBOdataTransparent(c->m_idxDataTransparent, c->m_vboDataTransparent);
+void Terrain::editsVisible(Chunk *c) {
+    auto it = m_pendingRemeshes.find(c);
+    if (it == m_pendingRemeshes.end()) {
+        return;
     }
-    m_chunksWithVBOData.clear();
-    m_chunksWithVBODataMux.unlock();
+    // Drawn by the paintGL that follows this tick
+    qint64 latency = m_clock.elapsed() - it->second.editedAt;
+    m_remeshLatencyTotal += latency;
+    m_remeshLatencyMax = std::max(m_remeshLatencyMax, latency);
+    m_remeshCount++;
+    m_pendingRemeshes.erase(it);
 }
 
 void Terrain::createRiver(ivec2 pos, float angle) {
@@ -320,12 +730,13 @@ void Terrain::createRiver(ivec2 pos, float angle) {
     river.rules.push_back(std::string("FF"));
     river.rules.push_back(std::string("F[-L]"));
     river.rules.push_back(std::string("F[+R]"));
-    river.constructLString(3, 0, .2); //iteration, replacement, branch
+    // Keyed by where the river starts, so each river has its own stream
+    CounterRng rng(streamKey(m_heightMap->seed(), RNG_RIVER, pos.x, pos.y));
+    river.constructLString(3, 0, .2, rng); //iteration, replacement, branch
     std::cout << river.lstring << std::endl;
 
     std::stack<Position> s;
     Position currPos = Position(vec3(pos.x, 140, pos.y), angle);
-    std::map<int64_t, int> chunks;
 
     ivec2 start = pos;
     ivec2 end = pos;
@@ -333,8 +744,8 @@ void Terrain::createRiver(ivec2 pos, float angle) {
         char c = river.lstring.at(i);
         switch (c) {
         case 'F': {
-            int fsize = 3.f + ((float) rand() / (RAND_MAX)) * 2.f; //5-10 block length per F
-            float ftype = ((float) rand() / (RAND_MAX)); //curves?
+            int fsize = 3.f + rng.nextFloat() * 2.f; //5-10 block length per F
+            float ftype = rng.nextFloat(); //curves?
             float curve = 0.f;
             if (ftype < .25) { //left
                 curve = 3.5;
@@ -345,9 +756,9 @@ void Terrain::createRiver(ivec2 pos, float angle) {
                 currPos.rotate(curve);
                 end = currPos.move(fsize);
                 if (hasChunkAt(start.x, start.y) && hasChunkAt(end.x, end.y)) {
-                    std::pair<int, Biome> h1 = HeightMap::getHeight(start.x, start.y);
-                    std::pair<int, Biome> h2 = HeightMap::getHeight(end.x, end.y);
-                    carveSeg(start, end, 3, 3, h1.first-1, h2.first-1, chunks);
+                    std::pair<int, Biome> h1 = groundAt(start.x, start.y);
+                    std::pair<int, Biome> h2 = groundAt(end.x, end.y);
+                    carveSeg(start, end, 3, 3, h1.first-1, h2.first-1);
                 }
 
 //                if (hasChunkAt(start.x, start.y)) { //inside circle
@@ -390,16 +801,9 @@ void Terrain::createRiver(ivec2 pos, float angle) {
         }
     }
 
-//    carveSeg(ivec2(45,45), ivec2(90,90), 5, 5, 140, chunks);
-//    carveSeg(ivec2(90,90), ivec2(110,110), 5, 5, 140, chunks);
-//    carveSeg(ivec2(45,45), ivec2(0,45), 5, 5, 140, chunks);
-
-    for (auto& a : chunks) {
-        ivec2 chunkXZ = toCoords(a.first);
-        uPtr<Chunk>& c = getChunkAt(chunkXZ.x, chunkXZ.y);
-        c->destroy();
-        createVBOData(c.get());
-    }
+//    carveSeg(ivec2(45,45), ivec2(90,90), 5, 5, 140);
+//    carveSeg(ivec2(90,90), ivec2(110,110), 5, 5, 140);
+//    carveSeg(ivec2(45,45), ivec2(0,45), 5, 5, 140);
 }
 
 float roundedCone(vec3 p, vec3 c1, vec3 c2, float r1, float r2) {
@@ -442,7 +846,7 @@ void rasterizeLine(LineSegment l, std::map<int, float>& entry, std::map<int, flo
     }
 }
 
-void Terrain::fillRiver(int z, int x1, int x2, int y, int r1, int r2, vec3 c1, vec3 c2, std::map<int64_t, int>& chunks) {
+void Terrain::fillRiver(int z, int x1, int x2, int y, int r1, int r2, vec3 c1, vec3 c2) {
     int bound = std::max(r1, r2);
     int ymin = y-bound-1;
     int ymax = y+bound+7;
@@ -453,20 +857,12 @@ void Terrain::fillRiver(int z, int x1, int x2, int y, int r1, int r2, vec3 c1, v
         for (int i=xmin; i<xmax; i++) {
             if (j >= y) {
                 if (hasChunkAt(i, z)) {
-                    int64_t end_chunk = toKey(i, z);
                     setBlockAt(i, j, z, EMPTY);
-                    if (chunks.count(end_chunk) == 0) {
-                        chunks.insert({end_chunk, 0});
-                    }
                 }
             } else {
                 float f = roundedCone(vec3(i, j, z), c1, c2, r1-.1, r2-.1);
                 if (f <= 0 && hasChunkAt(i, z)) {
-                    int64_t end_chunk = toKey(i, z);
                     setBlockAt(i, j, z, WATER);
-                    if (chunks.count(end_chunk) == 0) {
-                        chunks.insert({end_chunk, 0});
-                    }
                 }
             }
         }
@@ -483,7 +879,7 @@ void Terrain::fillRiver(int z, int x1, int x2, int y, int r1, int r2, vec3 c1, v
 //    }
 }
 
-void Terrain::fillAboveRiver(int z, int x1, int x2, int y, int r1, int r2, vec3 c1, vec3 c2, std::map<int64_t, int>& chunks) {
+void Terrain::fillAboveRiver(int z, int x1, int x2, int y, int r1, int r2, vec3 c1, vec3 c2) {
     int xmin = std::min(x1,x2);
     int xmax = std::max(x1,x2);
 
@@ -491,15 +887,11 @@ void Terrain::fillAboveRiver(int z, int x1, int x2, int y, int r1, int r2, vec3
         //the smaler the f value, the lower the height
         int j = y;
         float f = roundedCone(vec3(i, j, z), c1, c2, r1-.1, r2-.1);
-        while (1) {
-            if (hasChunkAt(i,z)) {
-                BlockType b = getBlockAt(i, j, z);
-                if (b == EMPTY) {
-                    break;
-                }
+        // Everything above the column's top block is air
+        if (hasChunkAt(i, z)) {
+            int top = surfaceHeight(i, z);
+            while (j <= top && getBlockAt(i, j, z) != EMPTY) {
                 j++;
-            } else {
-                break;
             }
         }
         if (f > 0) {
@@ -509,15 +901,11 @@ void Terrain::fillAboveRiver(int z, int x1, int x2, int y, int r1, int r2, vec3
                 diff *= scale;
     //            std::cout << "x,z " << x << "," << i << " F: " << f << " ymax: " << j << " New max: "
     //                      << y+std::floor(diff) << std::endl;
-                std::pair<int, Biome> temp = HeightMap::getHeight(i, z);
-                setBlockAt(i, y+std::floor(diff), z, BlockTypeWorker::m_topBlockMap[temp.second]);
+                std::pair<int, Biome> temp = groundAt(i, z);
+                setBlockAt(i, y+std::floor(diff), z, biomeProperties(temp.second).topBlock);
                 for (int k=y+std::floor(diff)+1; k<j; k++) {
                     if (hasChunkAt(i, z)) { //inside circle
-                       int64_t end_chunk = toKey(i, z);
                        setBlockAt(i, k, z, EMPTY);
-                       if (chunks.count(end_chunk) == 0) {
-                           chunks.insert({end_chunk, 0});
-                       }
                    }
                 }
             }
@@ -525,7 +913,7 @@ void Terrain::fillAboveRiver(int z, int x1, int x2, int y, int r1, int r2, vec3
     }
 }
 
-void Terrain::carveSeg(ivec2 start, ivec2 end, int r1, int r2, int y1, int y2, std::map<int64_t, int>& chunks) {
+void Terrain::carveSeg(ivec2 start, ivec2 end, int r1, int r2, int y1, int y2) {
     float bound = std::max(r1, r2);
     vec2 core = end-start;
     vec3 cross = normalize(glm::cross(vec3(core.x, core.y, 0.f), vec3(0.f, 0.f, 1.f)));
@@ -575,11 +963,11 @@ void Terrain::carveSeg(ivec2 start, ivec2 end, int r1, int r2, int y1, int y2, s
 
     for (auto& a : entry) {
         float ex = exit[a.first];
-        fillRiver(a.first, std::round(a.second), std::round(ex), (y1+y2)/2, r1, r2, c1, c2, chunks);
+        fillRiver(a.first, std::round(a.second), std::round(ex), (y1+y2)/2, r1, r2, c1, c2);
     }
     for (auto& a : bigEntry) {
         float ex = bigExit[a.first];
-        fillAboveRiver(a.first, std::round(a.second), std::round(ex), (y1+y2)/2, r1, r2, c1, c2, chunks);
+        fillAboveRiver(a.first, std::round(a.second), std::round(ex), (y1+y2)/2, r1, r2, c1, c2);
     }
 }
 
@@ -589,24 +977,23 @@ void Terrain::CreateTestScene()
     // store the blocks for our
     // initial world space
     QSet<int64_t> initBorderingZones = zonesBorderingZone(ivec2(0,0), 2);
+    m_wantedZones = initBorderingZones;
     for (auto id : initBorderingZones) {
         spawnBlockTypeWorker(id);
     }
-    QThreadPool::globalInstance()->waitForDone();
+    // Every chunk is generated, then meshed as soon as its neighbors are
+    m_scheduler.dispatchAll();
+    m_jobs.waitForDone();
 
-    m_chunksWithBlockDataMux.lock();
-    spawnVBOWorkers(m_chunksWithBlockData);
-    m_chunksWithBlockData.clear();
-    m_chunksWithBlockDataMux.unlock();
-    QThreadPool::globalInstance()->waitForDone();
-
-    m_chunksWithVBODataMux.lock();
-    for (uPtr<ChunkVBOData>& c : m_chunksWithVBOData) {
-        c->mp_chunk->createVBOdata(c->m_idxDataOpaque, c->m_vboDataOpaque);
-        c->mp_chunk->createVBOdataTransparent(c->m_idxDataTransparent, c->m_vboDataTransparent);
+    Chunk *generated;
+    while (m_chunksWithBlockData.tryPop(generated)) {
+        m_generateTasks.erase(generated);
+    }
+    m_jobs.runMainTasks();
+    for (auto &kv : m_meshesToUpload) {
+        uploadVBOData(*kv.second);
     }
-    m_chunksWithVBOData.clear();
-    m_chunksWithVBODataMux.unlock();
+    m_meshesToUpload.clear();
     m_initialSceneLoaded = true;
 }
 
@@ -4,13 +4,19 @@
 #include "chunk.h"
 #include <array>
 #include <unordered_map>
-#include <QThreadPool>
+#include <QElapsedTimer>
 #include <unordered_set>
 #include "shaderprogram.h"
 #include "heightmap.h"
 #include "vboworker.h"
 #include "blocktypeworker.h"
 #include "lsystem.h"
+#include "chunkscheduler.h"
+#include "chunkmap.h"
+#include "chunkgrid.h"
+#include "mpscqueue.h"
+#include "meshbufferpool.h"
+#include "jobsystem.h"
 #include <stack>
 
 using namespace glm;
@@ -24,11 +30,47 @@ glm::ivec2 toCoords(int64_t k);
 
 struct ChunkVBOData;
 enum BlockType: unsigned char;
+enum MeshMode: unsigned char;
+enum CaveMode: unsigned char;
+
+// Running totals of the chunk meshes uploaded by one mesher, used to
+// compare the per-face and greedy meshers
+struct MeshStats {
+    int chunks;
+    size_t vertices;
+    // Of the shared quad index buffer, six for each quad drawn
+    size_t indices;
+
+    MeshStats() : chunks(0), vertices(0), indices(0) {}
+};
+
+// An edited chunk whose edits are not visible yet
+struct PendingRemesh {
+    // Terrain::m_clock time of the first edit not visible yet
+    qint64 editedAt;
+    // Chunk::generation() of the newest remesh job started for the edits
+    unsigned generation;
+};
+
+// Time spent uploading finished bulk meshes, per tick that uploaded any
+struct UploadStats {
+    int frames;
+    int chunks;
+    size_t bytes;
+    // In microseconds
+    qint64 lastFrame;
+    qint64 maxFrame;
+    qint64 total;
+
+    UploadStats() : frames(0), chunks(0), bytes(0), lastFrame(0), maxFrame(0), total(0) {}
+};
 
 // The container class for all of the Chunks in the game.
 // Ultimately, while Terrain will always store all Chunks,
 // not all Chunks will be drawn at any given time as the world
 // expands.
+class HeightMap;
+
 class Terrain {
 private:
     // Stores every Chunk according to the location of its lower-left corner
@@ -36,7 +78,11 @@ private:
     // We combine the X and Z coordinates of the Chunk's corner into one 64-bit int
     // so that we can use them as a key for the map, as objects like std::pairs or
     // glm::ivec2s are not hashable by default, so they cannot be used as keys.
-    std::unordered_map<int64_t, uPtr<Chunk>> m_chunks;
+    // Lookups are safe from any thread; only the main thread inserts.
+    ChunkMap m_chunks;
+    // The chunks around the player, for the lookups made every frame by
+    // drawing and physics. Recentred on the player every tick.
+    ChunkGrid m_grid;
 
     // We will designate every 64 x 64 area of the world's x-z plane
     // as one "terrain generation zone". Every time the player moves
@@ -52,19 +98,102 @@ private:
     // surrounding the Player should be rendered, the Chunks
     // in the Terrain will never be deleted until the program is terminated.
     std::unordered_set<int64_t> m_generatedTerrain;
+    // Every chunk is generated by its own BlockTypeWorker. This counts the
+    // chunks of each zone that are not generated yet; the worker that
+    // finishes a zone's last chunk adds the zone to m_generatedTerrain.
+    // Both are guarded by m_genTerrainMux.
+    std::unordered_map<int64_t, int> m_zoneChunksLeft;
     QMutex m_genTerrainMux;
-    std::vector<uPtr<ChunkVBOData>> m_chunksWithVBOData;
-    QMutex m_chunksWithVBODataMux;
-    std::unordered_set<Chunk*> m_chunksWithBlockData;
-    QMutex m_chunksWithBlockDataMux;
+    // Zones all of whose chunks have had their generation scheduled,
+    // including finished ones
+    std::unordered_set<int64_t> m_requestedZones;
+    // Chunks whose generation jobs were dropped before they started,
+    // scheduled again when their zone is requested again
+    std::unordered_set<Chunk*> m_droppedGenerations;
+    // Every chunk is generated, meshed and uploaded by a chain of tasks.
+    // Its mesh task waits on the generation tasks of the chunk and of its
+    // neighbors, so that it is meshed once against all of them, and its
+    // upload task waits on the mesh task.
+    // The generation task of each chunk, until the main thread sees that
+    // it has finished
+    std::unordered_map<Chunk*, sPtr<Task>> m_generateTasks;
+    // The newest mesh task of each chunk, bulk or remesh. A neighbor whose
+    // generation is queued after it has started meshes the chunk again.
+    std::unordered_map<Chunk*, sPtr<Task>> m_meshTasks;
+    // The zones around the player that should be generated and drawn
+    QSet<int64_t> m_wantedZones;
+    // m_clock time at which each zone was scheduled, until its first chunk
+    // is uploaded, for the time-to-first-visible-chunk metric (in ms)
+    std::unordered_map<int64_t, qint64> m_zoneRequestedAt;
+    qint64 m_firstVisibleTotal;
+    qint64 m_firstVisibleMax;
+    int m_firstVisibleCount;
+    // Vertex buffers for the meshes below; declared first so that it
+    // outlives every mesh that returns its buffers to it
+    MeshBufferPool m_meshBuffers;
+    // Chunks whose blocks have been generated, handed to the main thread by
+    // the workers. It must hold every chunk that may finish before the main
+    // thread next drains it; CreateTestScene starts 400 chunks at once.
+    MPSCQueue<Chunk*> m_chunksWithBlockData;
+    // Finished bulk meshes, after generation or when a zone comes back into
+    // view, put here by their upload tasks and not uploaded yet, newest per
+    // chunk. Every tick the ones nearest the player are uploaded until
+    // m_uploadBudgetMs or m_uploadBudgetBytes is spent, and the rest wait
+    // for the next tick.
+    std::unordered_map<Chunk*, uPtr<ChunkVBOData>> m_meshesToUpload;
+    float m_uploadBudgetMs;
+    size_t m_uploadBudgetBytes;
+    UploadStats m_uploadStats;
+
+    // Chunks written to through setBlockAt since the last tick, including
+    // neighbours whose border faces the writes may have hidden or exposed
+    std::unordered_set<Chunk*> m_dirtyChunks;
+
+    // Chunks remeshed after a block edit. Their mesh tasks run ahead of
+    // generation and bulk meshing, and are uploaded as soon as they finish;
+    // the chunk keeps drawing its old mesh until then.
+    // An entry is removed once a mesh made after its newest remesh job
+    // started is uploaded, whether that is the remesh or a bulk mesh.
+    std::unordered_map<Chunk*, PendingRemesh> m_pendingRemeshes;
+    // Click-to-visible latency of edits, in ms
+    QElapsedTimer m_clock;
+    qint64 m_remeshLatencyTotal;
+    qint64 m_remeshLatencyMax;
+    int m_remeshCount;
+
+    // The mesher new VBOWorkers use, and what each mesher has uploaded so far
+    MeshMode m_meshMode;
+    std::array<MeshStats, 2> m_meshStats;
+
+    // How every chunk of this world carves its caves
+    CaveMode m_caveMode;
+    // The world's noise, picked by its seed, which also keys its random
+    // streams. Seed 0 is the world generated before there were seeds.
+    // Held by pointer because heightmap.h may include this header first.
+    uPtr<HeightMap> m_heightMap;
+
+    // Every chunk mesh is a list of four-vertex quads, so all of them are
+    // drawn with this one index buffer, which holds the indices of
+    // m_quadIdxCapacity quads and grows to fit the largest mesh uploaded
+    GLuint m_bufQuadIdx;
+    int m_quadIdxCapacity;
 
     float m_tryExpansionTimer;
     boolean m_initialSceneLoaded;
     OpenGLContext* mp_context;
 
+    // Declared after everything its workers use, so that they have
+    // stopped before any of it is destroyed
+    JobSystem m_jobs;
+    // Orders generation and meshing tasks by distance and view direction
+    // and submits them to m_jobs
+    ChunkScheduler m_scheduler;
+
 public:
-    Terrain(OpenGLContext *context);
+    Terrain(OpenGLContext *context, CaveMode caves, uint64_t seed);
     static int64_t toKey(int x, int z);
+    // The key of the terrain generation zone containing world-space (x, z)
+    static int64_t zoneOf(int x, int z);
     ~Terrain();
 
     // Instantiates a new Chunk and stores it in
@@ -73,30 +202,57 @@ public:
     Chunk* instantiateChunkAt(int x, int z);
     // Do these world-space coordinates lie within
     // a Chunk that exists?
+    // This and the block accessors below look in m_grid first
+    // and are only for the main thread.
     bool hasChunkAt(int x, int z) const;
-    // Assuming a Chunk exists at these coords,
-    // return a mutable reference to it
-    uPtr<Chunk>& getChunkAt(int x, int z);
-    // Assuming a Chunk exists at these coords,
-    // return a const reference to it
-    const uPtr<Chunk>& getChunkAt(int x, int z) const;
+    // The Chunk containing these world-space coordinates,
+    // or nullptr if there is none. Safe to call from any thread.
+    Chunk* getChunkAt(int x, int z) const;
+    // getChunkAt for the main thread, looking in m_grid first
+    Chunk* loadedChunkAt(int x, int z) const;
     // Given a world-space coordinate (which may have negative
     // values) return the block stored at that point in space.
     BlockType getBlockAt(int x, int y, int z) const;
     BlockType getBlockAt(glm::vec3 p) const;
+    // Y of the highest non-EMPTY block in the column at world-space (x, z),
+    // or -1 if it is all air or not generated yet. Throws like getBlockAt
+    // if there is no Chunk.
+    int surfaceHeight(int x, int z) const;
+    // The ground height and biome HeightMap::getHeight gives world-space
+    // (x, z), read from the generated Chunk holding it if there is one
+    std::pair<int, Biome> groundAt(int x, int z) const;
     // Given a world-space coordinate (which may have negative
     // values) set the block at that point in space to the
-    // given type.
+    // given type. The chunk is marked dirty and remeshed on the next tick.
     void setBlockAt(int x, int y, int z, BlockType t);
+    // Marks the chunk holding chunk-local column (x, z) dirty, along with the
+    // neighbour it borders if the column is on the chunk's edge
+    void markDirty(Chunk*, int x, int z);
+    // Remeshes every dirty chunk once
+    void remeshDirtyChunks();
 
-    void spawnVBOWorkers(const std::unordered_set<Chunk*> &);
     void spawnBTWorkers(const std::unordered_set<int64_t> &);
 
-    void checkThreadResults();
+    // Runs the upload tasks of finished meshes, uploading remeshes at once
+    // and what fits in this tick's upload budget of the rest, nearest to
+    // pos first
+    void checkThreadResults(glm::vec3 pos);
+    void uploadMeshes(glm::vec3 pos);
+    // At least one mesh is uploaded per tick whatever the budget
+    void setUploadBudget(float ms, size_t bytes);
+    float uploadBudgetMs() const;
+    size_t uploadBudgetBytes() const;
+    // Also prints how long zones took to show their first chunk
+    void printUploadStats() const;
+    // Prints how many chunks are in each ChunkState
+    void printChunkStates() const;
     QSet<int64_t> zonesBorderingZone(ivec2, int );
     boolean terrainZoneExists(int64_t);
-    void tryExpansion(glm::vec3, glm::vec3);
-    void multiThreadedWork(glm::vec3, glm::vec3, float);
+    // Updates m_wantedZones around the player, dropping waiting jobs for
+    // zones that left it and scheduling the zones that entered it
+    void tryExpansion(glm::vec3 pos);
+    // Called every tick with the player's position and view direction
+    void multiThreadedWork(glm::vec3 pos, glm::vec3 forward, float dT);
 
     // Draws every Chunk that falls within the bounding box
     // described by the min and max coords, using the provided
@@ -104,15 +260,47 @@ public:
     void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
     void drawOpaque(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
 
-    void spawnVBOWorker(Chunk*);
+    // Blocks until every task the workers can run has finished
+    void waitForJobs();
+
+    // Makes a mesh task for the chunk, waiting on the generation tasks of
+    // the chunk and its neighbors, and the upload task that follows it.
+    // Meshes made before it are out of date.
+    sPtr<Task> makeMeshTask(Chunk*, bool remesh);
+    // Schedules a bulk mesh of the chunk, if its zone is wanted
+    void meshChunk(Chunk*);
+    // Makes the newest mesh task of each neighbor of a chunk whose
+    // generation was just scheduled wait on it, and meshes the neighbors
+    // whose mesh task has already started again
+    void meshNeighborsAfter(Chunk*, const sPtr<Task> &generate);
     void spawnBlockTypeWorker(int64_t);
 
-    void createVBOData(Chunk*);
+    // Queues a high-priority remesh of a chunk whose blocks were edited
+    void remeshChunk(Chunk*);
+    // Uploads a finished remesh if it is still the newest for its chunk,
+    // dropping it if its zone has left the view
+    void uploadRemesh(uPtr<ChunkVBOData>);
+    // Records how long the chunk's pending edits took to become visible,
+    // once a mesh holding them is uploaded
+    void editsVisible(Chunk*);
+    // Sends a finished mesh to the GPU and adds it to m_meshStats
+    void uploadVBOData(ChunkVBOData &);
+    // Grows m_bufQuadIdx to hold at least this many quads
+    void reserveQuadIndices(int quads);
+
+    // Switches the mesher and remeshes every chunk currently drawn. Each
+    // chunk keeps drawing its old mesh until the new one is uploaded.
+    void setMeshMode(MeshMode);
+    MeshMode meshMode() const;
+    CaveMode caveMode() const;
+    uint64_t seed() const;
+    // Also prints how long edits took to become visible
+    void printMeshStats() const;
 
     void createRiver(ivec2, float);
-    void carveSeg(ivec2, ivec2, int r1, int r2, int y1, int y2, std::map<int64_t, int>& chunks);
-    void fillRiver(int, int, int, int, int, int, vec3, vec3, std::map<int64_t, int>& chunks);
-    void fillAboveRiver(int, int, int, int, int, int, vec3, vec3, std::map<int64_t, int>& chunks);
+    void carveSeg(ivec2, ivec2, int r1, int r2, int y1, int y2);
+    void fillRiver(int, int, int, int, int, int, vec3, vec3);
+    void fillAboveRiver(int, int, int, int, int, int, vec3, vec3);
 
     // Initializes the Chunks that store the 64 x 256 x 64 block scene you
     // see when the base code is run.
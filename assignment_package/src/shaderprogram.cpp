@@ -1,4 +1,5 @@
 #include "shaderprogram.h"
+#include "scene/chunkvertex.h"
 #include <QFile>
 #include <QStringBuilder>
 #include <QTextStream>
@@ -8,7 +9,7 @@
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
-      attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1),
+      attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1), attrPacked(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1), unifSampler2D(-1), unifNMap(-1),
       unifDepthVP(-1), unifShadowMap(-1),
       context(context)
@@ -68,6 +69,7 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     if(attrCol == -1) attrCol = context->glGetAttribLocation(prog, "vs_ColInstanced");
     attrPosOffset = context->glGetAttribLocation(prog, "vs_OffsetInstanced");
     attrUV = context->glGetAttribLocation(prog, "vs_UV");
+    attrPacked = context->glGetAttribLocation(prog, "vs_Packed");
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
@@ -240,7 +242,7 @@ void ShaderProgram::draw(Drawable &d)
     context->printGLErrorLog();
 }
 
-void ShaderProgram::drawInterleaved(Drawable &d)
+void ShaderProgram::drawInterleaved(Drawable &d, GLuint quadIdx)
 {
     useMe();
 
@@ -248,92 +250,44 @@ void ShaderProgram::drawInterleaved(Drawable &d)
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
     }
 
-    // Each of the following blocks checks that:
-    //   * This shader has this attribute, and
-    //   * This Drawable has a vertex buffer for this attribute.
-    // If so, it binds the appropriate buffers to each attribute.
-
-    // Remember, by calling bindPos(), we call
-    // glBindBuffer on the Drawable's VBO for vertex position,
-    // meaning that glVertexAttribPointer associates vs_Pos
-    // (referred to by attrPos) with that VBO
-    if (attrPos != -1 && d.bindInter()) {
-        context->glEnableVertexAttribArray(attrPos);
-        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)0);
-    }
-
-    if (attrNor != -1 && d.bindInter()) {
-        context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)sizeof(glm::vec4));
-    }
-
-    if (attrUV != -1 && d.bindInter()) {
-        context->glEnableVertexAttribArray(attrUV);
-        context->glVertexAttribPointer(attrUV, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(2*sizeof(glm::vec4)));
-    }
-
-    if (attrCol != -1 && d.bindInter()) {
-        context->glEnableVertexAttribArray(attrCol);
-        context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(3*sizeof(glm::vec4)));
+    // Chunk vertices are two packed unsigned ints (see chunkvertex.h),
+    // so they are bound with glVertexAttribIPointer to reach the shader as a uvec2
+    if (attrPacked != -1 && d.bindInter()) {
+        context->glEnableVertexAttribArray(attrPacked);
+        context->glVertexAttribIPointer(attrPacked, 2, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)0);
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdx();
+    context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIdx);
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
+    if (attrPacked != -1) context->glDisableVertexAttribArray(attrPacked);
 
     context->printGLErrorLog();
 }
 
-void ShaderProgram::drawInterleavedTransparent(Drawable &d)
+void ShaderProgram::drawInterleavedTransparent(Drawable &d, GLuint quadIdx)
 {
     useMe();
 
-    if(d.elemCount() < 0) {
-        throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
-    }
-
-    // Each of the following blocks checks that:
-    //   * This shader has this attribute, and
-    //   * This Drawable has a vertex buffer for this attribute.
-    // If so, it binds the appropriate buffers to each attribute.
-
-    // Remember, by calling bindPos(), we call
-    // glBindBuffer on the Drawable's VBO for vertex position,
-    // meaning that glVertexAttribPointer associates vs_Pos
-    // (referred to by attrPos) with that VBO
-    if (attrPos != -1 && d.bindInterT()) {
-        context->glEnableVertexAttribArray(attrPos);
-        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)0);
-    }
-
-    if (attrNor != -1 && d.bindInterT()) {
-        context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)sizeof(glm::vec4));
+    if(d.elemCountT() < 0) {
+        throw std::out_of_range("Attempting to draw a drawable with m_countT of " + std::to_string(d.elemCountT()) + "!");
     }
 
-    if (attrUV != -1 && d.bindInterT()) {
-        context->glEnableVertexAttribArray(attrUV);
-        context->glVertexAttribPointer(attrUV, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(2*sizeof(glm::vec4)));
-    }
-
-    if (attrCol != -1 && d.bindInterT()) {
-        context->glEnableVertexAttribArray(attrCol);
-        context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(3*sizeof(glm::vec4)));
+    // Chunk vertices are two packed unsigned ints (see chunkvertex.h),
+    // so they are bound with glVertexAttribIPointer to reach the shader as a uvec2
+    if (attrPacked != -1 && d.bindInterT()) {
+        context->glEnableVertexAttribArray(attrPacked);
+        context->glVertexAttribIPointer(attrPacked, 2, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)0);
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdxT();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+    context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIdx);
+    context->glDrawElements(d.drawMode(), d.elemCountT(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
+    if (attrPacked != -1) context->glDisableVertexAttribArray(attrPacked);
 
     context->printGLErrorLog();
 }
@@ -19,6 +19,7 @@ public:
     int attrNor; // A handle for the "in" vec4 representing vertex normal in the vertex shader
     int attrCol; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrUV;
+    int attrPacked; // A handle for the "in" uvec2 holding a packed chunk vertex
     int attrPosOffset; // A handle for a vec3 used only in the instanced rendering shader
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
@@ -57,10 +58,11 @@ public:
     void setSMap(int slot);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
-    // Draw the given object to our screen using this ShaderProgram's shaders with pos, nor and color interleaved
-    void drawInterleaved(Drawable &d);
+    // Draw the opaque or transparent mesh of a chunk, whose packed vertices form
+    // quads indexed by the shared quad index buffer quadIdx
+    void drawInterleaved(Drawable &d, GLuint quadIdx);
 
-    void drawInterleavedTransparent(Drawable &d);
+    void drawInterleavedTransparent(Drawable &d, GLuint quadIdx);
     // Draw the given object to our screen multiple times using instanced rendering
     void drawInstanced(InstancedDrawable &d);
     // Utility function used in create()
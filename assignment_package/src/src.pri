@@ -21,8 +21,15 @@ SOURCES += \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
+    $$PWD/scene/chunksection.cpp \
+    $$PWD/scene/chunkmap.cpp \
+    $$PWD/scene/chunkgrid.cpp \
+    $$PWD/scene/noisekernels.cpp \
     $$PWD/texture.cpp \
-    $$PWD/vboworker.cpp
+    $$PWD/vboworker.cpp \
+    $$PWD/meshbufferpool.cpp \
+    $$PWD/chunkscheduler.cpp \
+    $$PWD/jobsystem.cpp
 
 HEADERS += \
     $$PWD/blocktypeworker.h \
@@ -45,7 +52,18 @@ HEADERS += \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
+    $$PWD/scene/chunksection.h \
+    $$PWD/scene/blockregistry.h \
+    $$PWD/scene/heighttile.h \
+    $$PWD/scene/noisekernels.h \
+    $$PWD/scene/counterrng.h \
+    $$PWD/scene/chunkmap.h \
+    $$PWD/scene/chunkgrid.h \
+    $$PWD/scene/chunkvertex.h \
     $$PWD/texture.h \
-    $$PWD/vboworker.h
+    $$PWD/vboworker.h \
+    $$PWD/meshbufferpool.h \
+    $$PWD/chunkscheduler.h \
+    $$PWD/jobsystem.h
 
 RESOURCES +=
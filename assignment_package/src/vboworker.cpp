@@ -1,80 +1,290 @@
 #include "vboworker.h"
+#include <QtAlgorithms>
+#include <algorithm>
 using namespace std;
 
-VBOWorker::VBOWorker(Chunk* c, std::vector<uPtr<ChunkVBOData>> &chunks,
-                     QMutex* mv)
-: m_chunk(c), m_chunks(chunks), vboMux(mv)
+ChunkVBOData::ChunkVBOData(Chunk* c, MeshMode mode, unsigned generation, MeshBufferPool &pool)
+ : mp_chunk(c), m_mode(mode), m_pool(pool),
+   m_vboDataOpaque(pool.acquire(c->lastMeshVertices(false))),
+   m_vboDataTransparent(pool.acquire(c->lastMeshVertices(true))),
+   m_generation(generation)
+{}
+
+ChunkVBOData::~ChunkVBOData() {
+    m_pool.release(std::move(m_vboDataOpaque));
+    m_pool.release(std::move(m_vboDataTransparent));
+}
+
+VBOWorker::VBOWorker(Chunk* c, uPtr<ChunkVBOData> &out, MeshBufferPool &buffers, MeshMode mode)
+: m_chunk(c), m_out(out), m_buffers(buffers), m_mode(mode), m_generation(c->generation())
 {}
 
 void VBOWorker::run() {
-    uPtr<ChunkVBOData> data = mkU<ChunkVBOData>(m_chunk);
-    for(int i = 0; i < 16; ++i) {
-        for(int j = 0; j < 256; ++j) {
-            for(int k = 0; k < 16; ++k) {
-            BlockType t = m_chunk->getBlockAt(i, j, k);
-                if(t != EMPTY) {
-                    BlockType ip;
-                    BlockType in;
-                    BlockType jp;
-                    BlockType jn;
-                    BlockType kp;
-                    BlockType kn;
-                    if (i == 15) {
-                        if (m_chunk->mcr_neighbors.at(XPOS)) {
-                            ip = m_chunk->mcr_neighbors.at(XPOS)->getBlockAt(0, j, k);
-                        } else {
-                            ip = EMPTY;
-                        }
-                    } else {
-                        ip = m_chunk->getBlockAt(i+1, j, k);
-                    }
-                    if (i == 0) {
-                        if (m_chunk->mcr_neighbors.at(XNEG)) {
-                            in = m_chunk->mcr_neighbors.at(XNEG)->getBlockAt(15, j, k);
-                        } else {
-                            in = EMPTY;
-                        }
-                    } else {
-                        in = m_chunk->getBlockAt(i-1, j, k);
-                    }
-                    if (j == 255) {
-                        jp = EMPTY;
-                    } else {
-                        jp = m_chunk->getBlockAt(i, j+1, k);
+    if (!m_chunk->advance(MESHING)) {
+        return;
+    }
+    uPtr<ChunkVBOData> data = mkU<ChunkVBOData>(m_chunk, m_mode, m_generation, m_buffers);
+    // Reused by every mesh job that runs on this thread
+    static thread_local std::vector<BlockType> blocks(PADDED_VOLUME, EMPTY);
+    Snapshot s = snapshot(blocks);
+    if (s.minY <= s.maxY) {
+        if (m_mode == GREEDY) {
+            meshGreedy(blocks, s, *data);
+        } else {
+            meshPerFace(blocks, s, *data);
+        }
+    }
+    // Fails if the chunk was evicted meanwhile, or another job got there first
+    m_chunk->transition(MESHING, MESH_READY);
+    m_out = move(data);
+}
+
+// Neighbor chunks are only read once their generation has finished,
+// since a chunk that is still being filled may repack its sections.
+// Each chunk is read under its blocks lock, so that edits made on the
+// main thread wait until the copy is done.
+VBOWorker::Snapshot VBOWorker::snapshot(std::vector<BlockType> &blocks) const {
+    Snapshot s;
+    QReadLocker locker(&m_chunk->blocksLock());
+    s.minY = m_chunk->minBlockY();
+    s.maxY = m_chunk->maxBlockY();
+    if (s.minY > s.maxY) {
+        return s;
+    }
+    // Rows -1 through maxY + 1, everything the meshers read
+    int topRow = std::min(s.maxY + 1, 256);
+    std::fill_n(blocks.begin(), PADDED_AREA * (topRow + 2), EMPTY);
+
+    std::array<BlockType, 4096> section;
+    for (int sy = 0; sy <= s.maxY >> 4; ++sy) {
+        const ChunkSection &cs = m_chunk->getSection(sy);
+        if (cs.isUniform()) {
+            BlockType t = cs.uniformType();
+            if (t == EMPTY) {
+                continue;
+            }
+            for (int y = sy * 16; y < sy * 16 + 16; ++y) {
+                for (int z = 0; z < 16; ++z) {
+                    std::fill_n(blocks.begin() + paddedIndex(0, y, z), 16, t);
+                }
+            }
+            continue;
+        }
+        cs.decode(section);
+        for (int y = 0; y < 16; ++y) {
+            for (int z = 0; z < 16; ++z) {
+                std::copy_n(section.begin() + 16 * y + 256 * z, 16,
+                            blocks.begin() + paddedIndex(0, sy * 16 + y, z));
+            }
+        }
+    }
+
+    locker.unlock();
+
+    // No block of this chunk lies above maxY, so its faces never look at
+    // the neighbors' blocks above it either
+    auto copyBorder = [&](Direction dir, int srcX, int srcZ, int dstX, int dstZ, int stepX, int stepZ) {
+        const Chunk *n = m_chunk->mcr_neighbors.at(dir);
+        if (n == nullptr || !n->blocksFilled()) {
+            return;
+        }
+        QReadLocker neighborLocker(&n->blocksLock());
+        for (int y = 0; y <= s.maxY; ++y) {
+            const ChunkSection &ns = n->getSection(y >> 4);
+            for (int i = 0; i < 16; ++i) {
+                blocks[paddedIndex(dstX + i * stepX, y, dstZ + i * stepZ)] =
+                        ns.getBlockAt(srcX + i * stepX, y & 15, srcZ + i * stepZ);
+            }
+        }
+    };
+    copyBorder(XPOS, 0, 0, 16, 0, 0, 1);
+    copyBorder(XNEG, 15, 0, -1, 0, 0, 1);
+    copyBorder(ZPOS, 0, 0, 0, 16, 1, 0);
+    copyBorder(ZNEG, 0, 15, 0, -1, 1, 0);
+    return s;
+}
+
+// Finds the visible faces of 16 blocks at a time. Every padded row of
+// blocks along x becomes a few bitmasks, bit x + 1 for each x from -1 to 16,
+// and the faces of a row are its blocks masked by the blocks that cover
+// them: the same row shifted by one for the x faces, and the rows above,
+// below, in front and behind for the others. This matches
+// Chunk::faceVisible:
+//   any block is covered by a solid block that is not translucent,
+//   translucent blocks are also covered by translucent blocks,
+//   and nothing is covered from above by an inset block.
+void VBOWorker::meshPerFace(const std::vector<BlockType> &blocks, const Snapshot &s, ChunkVBOData &data) {
+    // Padded rows y = -1 .. maxY + 1, each holding z = -1 .. 16,
+    // so that row (y, z) is (z + 1) + PADDED_X * (y + 1)
+    const int rows = PADDED_X * (s.maxY + 3);
+    static thread_local std::vector<uint32_t> solid, translucent, inset;
+    solid.resize(rows);
+    translucent.resize(rows);
+    inset.resize(rows);
+    for (int r = 0; r < rows; ++r) {
+        const BlockType *row = blocks.data() + r * PADDED_X;
+        uint32_t sm = 0, tm = 0, im = 0;
+        for (int b = 0; b < PADDED_X; ++b) {
+            BlockType t = row[b];
+            sm |= static_cast<uint32_t>(t != EMPTY) << b;
+            const BlockProperties &p = blockProperties(t);
+            tm |= static_cast<uint32_t>(p.translucent) << b;
+            im |= static_cast<uint32_t>(p.inset) << b;
+        }
+        solid[r] = sm;
+        translucent[r] = tm;
+        inset[r] = im;
+    }
+
+    // Bits of x = 0 .. 15, the blocks of this chunk
+    const uint32_t inside = 0xFFFFu << 1;
+    for (int y = s.minY; y <= s.maxY; ++y) {
+        for (int z = 0; z < 16; ++z) {
+            int r = (z + 1) + PADDED_X * (y + 1);
+            // Blocks only translucent blocks don't cover, and those they do
+            uint32_t plain = solid[r] & ~translucent[r] & inside;
+            uint32_t clear = translucent[r] & inside;
+            if ((plain | clear) == 0) {
+                continue;
+            }
+            // Faces of the row left uncovered by blocks whose masks are nSolid and nTranslucent
+            auto exposed = [&](uint32_t nSolid, uint32_t nTranslucent) {
+                return (plain & ~(nSolid & ~nTranslucent)) | (clear & ~nSolid);
+            };
+            std::array<uint32_t, 6> faces;
+            faces[XPOS] = exposed(solid[r] >> 1, translucent[r] >> 1);
+            faces[XNEG] = exposed(solid[r] << 1, translucent[r] << 1);
+            faces[YPOS] = exposed(solid[r + PADDED_X] & ~inset[r + PADDED_X], translucent[r + PADDED_X]);
+            faces[YNEG] = exposed(solid[r - PADDED_X], translucent[r - PADDED_X]);
+            faces[ZPOS] = exposed(solid[r + 1], translucent[r + 1]);
+            faces[ZNEG] = exposed(solid[r - 1], translucent[r - 1]);
+
+            uint32_t any = faces[XPOS] | faces[XNEG] | faces[YPOS] | faces[YNEG] | faces[ZPOS] | faces[ZNEG];
+            while (any != 0) {
+                int bit = static_cast<int>(qCountTrailingZeroBits(any));
+                any &= any - 1;
+                unsigned int blockFaces = 0;
+                for (int d = 0; d < 6; ++d) {
+                    blockFaces |= ((faces[d] >> bit) & 1u) << d;
+                }
+                int x = bit - 1;
+                BlockType t = blocks[paddedIndex(x, y, z)];
+                m_chunk->createVBOdataCube(t, blockFaces, glm::ivec3(x, y, z),
+                                           blockProperties(t).transparent ? data.m_vboDataTransparent
+                                                                          : data.m_vboDataOpaque);
+            }
+        }
+    }
+}
+
+// For each of the six face directions, sweeps the chunk one slice at a time.
+// Every slice gets a 2D mask of the block types whose face in that direction
+// is visible, and the mask is then covered with as few rectangles as possible
+// by growing each one along v2 first and then along v1.
+void VBOWorker::meshGreedy(const std::vector<BlockType> &blocks, const Snapshot &snap, ChunkVBOData &data) {
+    auto blockAt = [&](int x, int y, int z) {
+        return blocks[paddedIndex(x, y, z)];
+    };
+
+    // Per direction: the axis the face points along, the axes of v1 and v2
+    // (matching Chunk::createVBOdataCube) and whether the face sits on the
+    // far side of its block
+    struct FaceAxes { Direction dir; int n, a1, a2; bool far; };
+    const std::array<FaceAxes, 6> faces {{
+        {XPOS, 0, 1, 2, true},
+        {XNEG, 0, 1, 2, false},
+        {YPOS, 1, 2, 0, true},
+        {YNEG, 1, 2, 0, false},
+        {ZPOS, 2, 1, 0, true},
+        {ZNEG, 2, 1, 0, false},
+    }};
+    // Nothing above the chunk's highest block needs sweeping
+    const glm::ivec3 dims(16, snap.maxY + 1, 16);
+    static thread_local std::vector<BlockType> mask;
+
+    for (const FaceAxes &f : faces) {
+        glm::ivec3 step(0);
+        step[f.n] = f.far ? 1 : -1;
+        int size1 = dims[f.a1];
+        int size2 = dims[f.a2];
+        mask.assign(size1 * size2, EMPTY);
+        for (int s = 0; s < dims[f.n]; ++s) {
+            // Build the mask of visible faces for this slice
+            bool any = false;
+            for (int p1 = 0; p1 < size1; ++p1) {
+                for (int p2 = 0; p2 < size2; ++p2) {
+                    glm::ivec3 c;
+                    c[f.n] = s;
+                    c[f.a1] = p1;
+                    c[f.a2] = p2;
+                    BlockType t = blockAt(c.x, c.y, c.z);
+                    BlockType m = EMPTY;
+                    if (t != EMPTY && Chunk::faceVisible(t, blockAt(c.x + step.x, c.y + step.y, c.z + step.z), f.dir)) {
+                        m = t;
+                        any = true;
                     }
-                    if (j == 0) {
-                        jn = EMPTY;
-                    } else {
-                        jn = m_chunk->getBlockAt(i, j-1, k);
+                    mask[p1 * size2 + p2] = m;
+                }
+            }
+            if (!any) {
+                continue;
+            }
+            // Cover the mask with rectangles
+            for (int p1 = 0; p1 < size1; ++p1) {
+                for (int p2 = 0; p2 < size2; ++p2) {
+                    BlockType t = mask[p1 * size2 + p2];
+                    if (t == EMPTY) {
+                        continue;
                     }
-                    if (k == 15) {
-                        if (m_chunk->mcr_neighbors.at(ZPOS)) {
-                            kp = m_chunk->mcr_neighbors.at(ZPOS)->getBlockAt(i, j, 0);
-                        } else {
-                            kp = EMPTY;
+                    int w = 1;
+                    int h = 1;
+                    // Inset faces stop short of the block edge, so
+                    // merging them would close the gaps between blocks
+                    const BlockProperties &p = blockProperties(t);
+                    if (!p.inset) {
+                        while (p2 + w < size2 && mask[p1 * size2 + p2 + w] == t) {
+                            ++w;
                         }
-                    } else {
-                        kp = m_chunk->getBlockAt(i, j, k+1);
-                    }
-                    if (k == 0) {
-                        if (m_chunk->mcr_neighbors.at(ZNEG)) {
-                            kn = m_chunk->mcr_neighbors.at(ZNEG)->getBlockAt(i, j, 15);
-                        } else {
-                            kn = EMPTY;
+                        bool grow = true;
+                        while (grow && p1 + h < size1) {
+                            for (int q = p2; q < p2 + w; ++q) {
+                                if (mask[(p1 + h) * size2 + q] != t) {
+                                    grow = false;
+                                    break;
+                                }
+                            }
+                            if (grow) {
+                                ++h;
+                            }
                         }
-                    } else {
-                        kn = m_chunk->getBlockAt(i, j, k-1);
                     }
-                    if (t == WATER || t == ICE || t == CACTUS) {
-                        m_chunk->createVBOdataCube(t, ip, in, jp, jn, kp, kn, glm::vec4(i, j, k, 0.f), data->m_idxDataTransparent, data->m_vboDataTransparent);
-                    } else {
-                        m_chunk->createVBOdataCube(t, ip, in, jp, jn, kp, kn, glm::vec4(i, j, k, 0.f), data->m_idxDataOpaque, data->m_vboDataOpaque);
+                    for (int r = p1; r < p1 + h; ++r) {
+                        std::fill_n(mask.begin() + r * size2 + p2, w, EMPTY);
+                    }
+
+                    glm::vec4 uvTop, uvBot, uv;
+                    Chunk::blockUVs(t, uvTop, uvBot, uv);
+                    if (f.dir == YPOS) {
+                        uv = uvTop;
+                    } else if (f.dir == YNEG) {
+                        uv = uvBot;
                     }
+                    glm::ivec3 blockPos(0);
+                    blockPos[f.n] = f.far ? s + 1 : s;
+                    blockPos[f.a1] = p1;
+                    blockPos[f.a2] = p2;
+                    glm::ivec3 v1(0);
+                    glm::ivec3 v2(0);
+                    v1[f.a1] = 1;
+                    v2[f.a2] = 1;
+                    // Only the sides of an inset block are inset
+                    bool inset = p.inset && f.n != 1;
+                    bool transparent = p.transparent;
+                    m_chunk->createVBOdataFace(blockPos, v1, v2, f.dir, inset, uv,
+                                               transparent ? data.m_vboDataTransparent : data.m_vboDataOpaque,
+                                               glm::ivec2(h, w));
                 }
             }
         }
     }
-    vboMux->lock();
-    m_chunks.push_back(move(data));
-    vboMux->unlock();
 }
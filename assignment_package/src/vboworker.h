@@ -1,33 +1,86 @@
 #pragma once
 #include <QRunnable>
 #include <QMutex>
+#include <array>
 #include <unordered_set>
+#include <vector>
 #include "scene/chunk.h"
 #include "scene/terrain.h"
+#include "scene/chunkvertex.h"
+#include "meshbufferpool.h"
 using namespace std;
 class Chunk;
+enum BlockType : unsigned char;
 
+// Which algorithm VBOWorker uses to turn block data into quads
+enum MeshMode : unsigned char
+{
+    // One quad for every exposed block face
+    PER_FACE,
+    // Coplanar adjacent faces of the same block type are merged
+    // into the largest rectangles that cover them
+    GREEDY
+};
+
+// A finished mesh. Its vertex buffers come from a MeshBufferPool, sized
+// after the chunk's last uploaded mesh, and go back to it when the mesh
+// is destroyed after upload or dropped.
 struct ChunkVBOData {
     Chunk* mp_chunk;
-    std::vector<glm::vec4> m_vboDataOpaque;
-    std::vector<GLuint> m_idxDataOpaque;
-    std::vector<glm::vec4> m_vboDataTransparent;
-    std::vector<GLuint> m_idxDataTransparent;
-
-    ChunkVBOData(Chunk* c)
-     : mp_chunk(c), m_vboDataOpaque(), m_idxDataOpaque(),
-       m_vboDataTransparent(), m_idxDataTransparent()
-    {}
+    MeshMode m_mode;
+    MeshBufferPool &m_pool;
+    std::vector<ChunkVertex> m_vboDataOpaque;
+    std::vector<ChunkVertex> m_vboDataTransparent;
+    // mp_chunk's generation when its job was made. The mesh is out of date
+    // once the chunk's generation has moved past it.
+    unsigned m_generation;
+
+    ChunkVBOData(Chunk* c, MeshMode mode, unsigned generation, MeshBufferPool &pool);
+    ~ChunkVBOData();
+    ChunkVBOData(const ChunkVBOData &) = delete;
+    ChunkVBOData &operator=(const ChunkVBOData &) = delete;
 };
 
 class VBOWorker : public QRunnable {
 private:
     Chunk* m_chunk;
-    std::vector<uPtr<ChunkVBOData>>& m_chunks;
-    QMutex *vboMux;
+    // Where the finished mesh goes, left empty if the chunk has no blocks yet
+    uPtr<ChunkVBOData>& m_out;
+    MeshBufferPool& m_buffers;
+    MeshMode m_mode;
+    // m_chunk's generation when this job was made, so that an edit made
+    // since makes the mesh out of date
+    unsigned m_generation;
+
+    // The meshers read a copy of the chunk padded with a one-block border
+    // taken from its neighbors, so that every block they look at, inside
+    // the chunk or just past its edge, is a plain array read.
+    // Chunk-local x and z run from -1 to 16 and y from -1 to 256.
+    static constexpr int PADDED_X = 18;
+    static constexpr int PADDED_AREA = 18 * 18;
+    static constexpr int PADDED_VOLUME = 18 * 18 * 258;
+    static int paddedIndex(int x, int y, int z) {
+        return (x + 1) + PADDED_X * (z + 1) + PADDED_AREA * (y + 1);
+    }
+
+    // What the meshers need to know about a snapshot besides its blocks
+    struct Snapshot {
+        // Every non-EMPTY block of the chunk lies within minY <= y <= maxY.
+        // Rows of the padded copy above maxY + 1 are left over from
+        // earlier snapshots and must not be read.
+        int minY;
+        int maxY;
+    };
+
+    // Copies m_chunk and the border of its generated neighbors into blocks,
+    // which must hold PADDED_VOLUME cells. Missing or ungenerated
+    // neighbors, and the rows below and above the chunk, read as EMPTY.
+    Snapshot snapshot(std::vector<BlockType> &blocks) const;
+    void meshPerFace(const std::vector<BlockType> &blocks, const Snapshot &s, ChunkVBOData &data);
+    void meshGreedy(const std::vector<BlockType> &blocks, const Snapshot &snap, ChunkVBOData &data);
 
 public:
-    VBOWorker(Chunk*, std::vector<uPtr<ChunkVBOData>> &,
-              QMutex*);
+    // out must outlive the worker
+    VBOWorker(Chunk*, uPtr<ChunkVBOData> &out, MeshBufferPool &, MeshMode mode = PER_FACE);
     void run() override;
 };
@@ -0,0 +1,20 @@
+#include "worldcheck.h"
+#include "blocktypeworker.h"
+
+std::vector<uint64_t> worldChecksums(uint64_t seed, CaveMode caves, int n) {
+    HeightMap heightMap(seed);
+    std::unordered_set<int64_t> generatedZones;
+    std::unordered_map<int64_t, int> zoneChunksLeft;
+    QMutex zonesMux;
+    MPSCQueue<Chunk*> generated(n * n);
+    std::vector<uint64_t> checksums;
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            Chunk chunk(nullptr, glm::ivec2(16 * x, 16 * z));
+            BlockTypeWorker(&chunk, generatedZones, zoneChunksLeft, &zonesMux,
+                            generated, heightMap, caves).run();
+            checksums.push_back(chunk.checksum());
+        }
+    }
+    return checksums;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+enum CaveMode: unsigned char;
+
+// Chunk::checksum of each of the n x n chunks whose lower-left corner is
+// (0, 0), indexed x + n * z in chunks. They are generated on this thread
+// by BlockTypeWorkers, without a window or OpenGL context, for
+// tests/auto/worldgen to compare with the checksums it recorded.
+std::vector<uint64_t> worldChecksums(uint64_t seed, CaveMode caves, int n);
@@ -0,0 +1,5 @@
+include(../../tests.pri)
+
+TARGET = tst_chunkmap
+
+SOURCES += tst_chunkmap.cpp
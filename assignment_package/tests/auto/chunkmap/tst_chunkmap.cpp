@@ -0,0 +1,78 @@
+#include <QtTest>
+#include "scene/chunkmap.h"
+#include "scene/chunk.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Chunks along each side of the square inserted by the stress test
+constexpr int SIDE = 256;
+constexpr unsigned READERS = 8;
+
+class TestChunkMap : public QObject {
+    Q_OBJECT
+
+private slots:
+    void findAfterInsert();
+    void concurrentFindDuringInsert();
+};
+
+void TestChunkMap::findAfterInsert() {
+    ChunkMap map;
+    QVERIFY(map.find(Terrain::toKey(0, 0)) == nullptr);
+    QVERIFY(!map.contains(Terrain::toKey(0, 0)));
+    Chunk *c = map.insert(Terrain::toKey(-16, 32), mkU<Chunk>(nullptr, glm::ivec2(-16, 32)));
+    QCOMPARE(map.find(Terrain::toKey(-16, 32)), c);
+    QVERIFY(map.contains(Terrain::toKey(-16, 32)));
+    QVERIFY(map.find(Terrain::toKey(32, -16)) == nullptr);
+}
+
+// Readers look up random chunks while this thread inserts SIDE x SIDE of
+// them, across every shard. A reader must only ever see a missing chunk
+// or the one stored at the key it asked for.
+void TestChunkMap::concurrentFindDuringInsert() {
+    ChunkMap map;
+    std::atomic<bool> stop(false);
+    std::atomic<long> lookups(0), hits(0), wrong(0);
+    std::vector<std::thread> readers;
+    for (unsigned i = 0; i < READERS; ++i) {
+        readers.emplace_back([&, i] {
+            unsigned r = i * 2654435761u + 1;
+            while (!stop) {
+                r = r * 1664525u + 1013904223u;
+                int x = (r >> 8) % SIDE * 16, z = (r >> 20) % SIDE * 16;
+                Chunk *c = map.find(Terrain::toKey(x, z));
+                lookups++;
+                if (c) {
+                    hits++;
+                    if (c->mcr_origin != glm::ivec2(x, z)) {
+                        wrong++;
+                    }
+                }
+            }
+        });
+    }
+    for (int x = 0; x < SIDE; ++x) {
+        for (int z = 0; z < SIDE; ++z) {
+            map.insert(Terrain::toKey(16 * x, 16 * z),
+                       mkU<Chunk>(nullptr, glm::ivec2(16 * x, 16 * z)));
+        }
+    }
+    stop = true;
+    for (std::thread &t : readers) {
+        t.join();
+    }
+
+    QCOMPARE(wrong.load(), 0L);
+    QVERIFY(lookups > 0);
+    int stored = 0;
+    map.forEach([&](Chunk *c) {
+        QVERIFY(map.find(Terrain::toKey(c->mcr_origin.x, c->mcr_origin.y)) == c);
+        stored++;
+    });
+    QCOMPARE(stored, SIDE * SIDE);
+    qDebug() << lookups.load() << "lookups," << hits.load() << "hits during insertion";
+}
+
+QTEST_MAIN(TestChunkMap)
+#include "tst_chunkmap.moc"
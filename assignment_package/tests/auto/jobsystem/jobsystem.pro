@@ -0,0 +1,5 @@
+include(../../tests.pri)
+
+TARGET = tst_jobsystem
+
+SOURCES += tst_jobsystem.cpp
@@ -0,0 +1,140 @@
+#include <QtTest>
+#include "jobsystem.h"
+#include <atomic>
+#include <vector>
+
+constexpr int THREADS = 4;
+constexpr int CHAINS = 64;
+constexpr int CHAIN_LENGTH = 50;
+
+class TestJobSystem : public QObject {
+    Q_OBJECT
+
+private slots:
+    void runsAfterDependencies();
+    void cancelReleasesDependents();
+    void addDependencyAfterReady();
+    void mainLaneRunsOnMainThread();
+    void manyChains();
+};
+
+// A diamond: b and c wait on a, d waits on both
+void TestJobSystem::runsAfterDependencies() {
+    JobSystem jobs(THREADS, 4);
+    std::atomic<int> step(0);
+    int ranA = -1, ranB = -1, ranC = -1, ranD = -1;
+    sPtr<Task> a = mkS<Task>(QRunnable::create([&]() { ranA = step++; }), WORKER_LANE);
+    sPtr<Task> b = mkS<Task>(QRunnable::create([&]() { ranB = step++; }), WORKER_LANE);
+    sPtr<Task> c = mkS<Task>(QRunnable::create([&]() { ranC = step++; }), WORKER_LANE);
+    sPtr<Task> d = mkS<Task>(QRunnable::create([&]() { ranD = step++; }), WORKER_LANE);
+    QVERIFY(jobs.addDependency(a, b));
+    QVERIFY(jobs.addDependency(a, c));
+    QVERIFY(jobs.addDependency(b, d));
+    QVERIFY(jobs.addDependency(c, d));
+    // Submitted last first, so only the waits keep them in order
+    jobs.submit(d);
+    jobs.submit(c);
+    jobs.submit(b);
+    jobs.submit(a);
+    jobs.waitForDone();
+
+    QCOMPARE(step.load(), 4);
+    QCOMPARE(ranA, 0);
+    QVERIFY(ranB > ranA && ranC > ranA);
+    QCOMPARE(ranD, 3);
+}
+
+void TestJobSystem::cancelReleasesDependents() {
+    JobSystem jobs(THREADS, 4);
+    bool ranBefore = false, ranAfter = false;
+    sPtr<Task> before = mkS<Task>(QRunnable::create([&]() { ranBefore = true; }), WORKER_LANE);
+    sPtr<Task> after = mkS<Task>(QRunnable::create([&]() { ranAfter = true; }), WORKER_LANE);
+    QVERIFY(jobs.addDependency(before, after));
+    jobs.submit(after);
+    jobs.cancel(before);
+    jobs.waitForDone();
+
+    QVERIFY(!ranBefore);
+    QVERIFY(ranAfter);
+    // A cancelled task never runs, so nothing can wait on it
+    sPtr<Task> other = mkS<Task>(QRunnable::create([]() {}), WORKER_LANE);
+    QVERIFY(!jobs.addDependency(other, before));
+    jobs.submit(other);
+    jobs.waitForDone();
+}
+
+void TestJobSystem::addDependencyAfterReady() {
+    JobSystem jobs(THREADS, 4);
+    sPtr<Task> first = mkS<Task>(QRunnable::create([]() {}), WORKER_LANE);
+    jobs.submit(first);
+    jobs.waitForDone();
+
+    // Already finished, so it adds no wait
+    sPtr<Task> second = mkS<Task>(QRunnable::create([]() {}), WORKER_LANE);
+    QVERIFY(jobs.addDependency(first, second));
+    jobs.submit(second);
+    jobs.waitForDone();
+
+    // second is ready and has run, so it cannot be made to wait
+    sPtr<Task> third = mkS<Task>(QRunnable::create([]() {}), WORKER_LANE);
+    QVERIFY(!jobs.addDependency(third, second));
+    jobs.submit(third);
+    jobs.waitForDone();
+}
+
+void TestJobSystem::mainLaneRunsOnMainThread() {
+    JobSystem jobs(THREADS, 4);
+    std::thread::id ranOn;
+    sPtr<Task> work = mkS<Task>(QRunnable::create([]() {}), WORKER_LANE);
+    sPtr<Task> main = mkS<Task>(QRunnable::create([&]() { ranOn = std::this_thread::get_id(); }),
+                                MAIN_LANE);
+    QVERIFY(jobs.addDependency(work, main));
+    jobs.submit(main);
+    jobs.submit(work);
+    jobs.waitForDone();
+
+    QVERIFY(ranOn == std::thread::id());
+    jobs.runMainTasks();
+    QVERIFY(ranOn == std::this_thread::get_id());
+}
+
+// Each task of a chain releases the next on the worker that ran it, so the
+// chains spread over the workers by being stolen. Every link must run
+// once, after the one before it.
+void TestJobSystem::manyChains() {
+    JobSystem jobs(THREADS, 1);
+    std::vector<std::atomic<int>> progress(CHAINS);
+    std::atomic<int> outOfOrder(0);
+    std::vector<sPtr<Task>> heads;
+    for (int c = 0; c < CHAINS; ++c) {
+        progress[c] = 0;
+        sPtr<Task> prev;
+        for (int i = 0; i < CHAIN_LENGTH; ++i) {
+            sPtr<Task> t = mkS<Task>(QRunnable::create([&progress, &outOfOrder, c, i]() {
+                if (progress[c]++ != i) {
+                    outOfOrder++;
+                }
+            }), i == 0 ? URGENT_LANE : WORKER_LANE);
+            if (prev != nullptr) {
+                QVERIFY(jobs.addDependency(prev, t));
+                jobs.submit(t);
+            } else {
+                heads.push_back(t);
+            }
+            prev = t;
+        }
+    }
+    for (const sPtr<Task> &t : heads) {
+        jobs.submit(t);
+    }
+    jobs.waitForDone();
+
+    QCOMPARE(outOfOrder.load(), 0);
+    for (int c = 0; c < CHAINS; ++c) {
+        QCOMPARE(progress[c].load(), CHAIN_LENGTH);
+    }
+    QCOMPARE(jobs.activeCount(), 0);
+}
+
+QTEST_MAIN(TestJobSystem)
+#include "tst_jobsystem.moc"
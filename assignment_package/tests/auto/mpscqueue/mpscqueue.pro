@@ -0,0 +1,5 @@
+include(../../tests.pri)
+
+TARGET = tst_mpscqueue
+
+SOURCES += tst_mpscqueue.cpp
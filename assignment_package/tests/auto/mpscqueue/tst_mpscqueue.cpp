@@ -0,0 +1,97 @@
+#include <QtTest>
+#include "mpscqueue.h"
+#include <thread>
+#include <vector>
+
+constexpr int PRODUCERS = 8;
+constexpr uint32_t ITEMS_PER_PRODUCER = 100000;
+
+class TestMPSCQueue : public QObject {
+    Q_OBJECT
+
+private slots:
+    void popsInPushOrder();
+    void tryPushFailsWhenFull();
+    void multipleProducers();
+};
+
+void TestMPSCQueue::popsInPushOrder() {
+    MPSCQueue<int> q(4);
+    int v;
+    QVERIFY(!q.tryPop(v));
+    // Several laps around the cells
+    for (int i = 0; i < 20; ++i) {
+        q.push(2 * i);
+        q.push(2 * i + 1);
+        QVERIFY(q.tryPop(v));
+        QCOMPARE(v, 2 * i);
+        QVERIFY(q.tryPop(v));
+        QCOMPARE(v, 2 * i + 1);
+    }
+    QVERIFY(!q.tryPop(v));
+}
+
+void TestMPSCQueue::tryPushFailsWhenFull() {
+    // Rounded up to 4 cells
+    MPSCQueue<uPtr<int>> q(3);
+    for (int i = 0; i < 4; ++i) {
+        uPtr<int> v = mkU<int>(i);
+        QVERIFY(q.tryPush(v));
+        QVERIFY(v == nullptr);
+    }
+    uPtr<int> extra = mkU<int>(4);
+    QVERIFY(!q.tryPush(extra));
+    QVERIFY(extra != nullptr);
+
+    uPtr<int> out;
+    QVERIFY(q.tryPop(out));
+    QCOMPARE(*out, 0);
+    QVERIFY(q.tryPush(extra));
+}
+
+// Producers push numbered items into a queue much smaller than what they
+// push, so they keep finding it full and racing for the same cells. Every
+// item must come out exactly once, and each producer's in the order it
+// pushed them.
+void TestMPSCQueue::multipleProducers() {
+    MPSCQueue<uint64_t> q(64);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&q, p] {
+            for (uint32_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+                q.push((uint64_t(p) << 32) | i);
+            }
+        });
+    }
+
+    std::vector<uint32_t> next(PRODUCERS, 0);
+    int outOfOrder = 0;
+    uint64_t popped = 0;
+    while (popped < uint64_t(PRODUCERS) * ITEMS_PER_PRODUCER) {
+        uint64_t v;
+        if (!q.tryPop(v)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int p = int(v >> 32);
+        QVERIFY(p < PRODUCERS);
+        if (uint32_t(v) != next[p]) {
+            outOfOrder++;
+        }
+        next[p] = uint32_t(v) + 1;
+        popped++;
+    }
+    for (std::thread &t : producers) {
+        t.join();
+    }
+
+    QCOMPARE(outOfOrder, 0);
+    for (int p = 0; p < PRODUCERS; ++p) {
+        QCOMPARE(next[p], ITEMS_PER_PRODUCER);
+    }
+    uint64_t v;
+    QVERIFY(!q.tryPop(v));
+}
+
+QTEST_MAIN(TestMPSCQueue)
+#include "tst_mpscqueue.moc"
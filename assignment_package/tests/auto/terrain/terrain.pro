@@ -0,0 +1,5 @@
+include(../../tests.pri)
+
+TARGET = tst_terrain
+
+SOURCES += tst_terrain.cpp
@@ -0,0 +1,133 @@
+#include <QtTest>
+#include "openglcontext.h"
+#include "scene/terrain.h"
+#include "vboworker.h"
+
+// Where the player stands in these tests, in the middle of the test scene
+const glm::vec3 PLAYER_POS(48.f, 140.f, 48.f);
+
+class TestTerrain : public QObject {
+    Q_OBJECT
+
+private:
+    uPtr<OpenGLContext> mp_context;
+
+    // Runs frames at pos, each after every job started so far has finished
+    void settle(Terrain &t, glm::vec3 pos);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void editSurvivesMeshModeSwitch();
+    void editSurvivesNeighborGeneration();
+    void remeshDroppedAfterEviction();
+};
+
+void TestTerrain::settle(Terrain &t, glm::vec3 pos) {
+    for (int i = 0; i < 100; ++i) {
+        t.waitForJobs();
+        t.multiThreadedWork(pos, glm::vec3(1.f, 0.f, 0.f), 0.f);
+    }
+    t.waitForJobs();
+}
+
+// Chunks upload their meshes, so the tests need a current context
+void TestTerrain::initTestCase() {
+    mp_context = mkU<OpenGLContext>(nullptr);
+    mp_context->show();
+    QVERIFY(QTest::qWaitForWindowExposed(mp_context.get()));
+    mp_context->makeCurrent();
+    if (!mp_context->isValid()) {
+        QSKIP("No OpenGL context");
+    }
+    mp_context->initializeOpenGLFunctions();
+}
+
+void TestTerrain::cleanupTestCase() {
+    mp_context.reset();
+}
+
+// Switching the mesher while an edited chunk waits on its remesh must
+// still leave the edit on the GPU
+void TestTerrain::editSurvivesMeshModeSwitch() {
+    Terrain t(mp_context.get(), NO_CAVES, 0);
+    t.CreateTestScene();
+    Chunk *c = t.getChunkAt(8, 8);
+    QCOMPARE(c->state(), UPLOADED);
+    QCOMPARE(t.getBlockAt(8, 250, 8), EMPTY);
+    unsigned before = c->lastMeshVertices(false);
+
+    t.setBlockAt(8, 250, 8, STONE);
+    t.remeshDirtyChunks();
+    t.setMeshMode(GREEDY);
+    t.setMeshMode(PER_FACE);
+    settle(t, PLAYER_POS);
+
+    QCOMPARE(c->state(), UPLOADED);
+    // Each of the six faces of the lone block
+    QCOMPARE(c->lastMeshVertices(false), before + 24);
+}
+
+// A neighbour finishing generation while an edited chunk waits on its
+// remesh must not keep the edit off the GPU
+void TestTerrain::editSurvivesNeighborGeneration() {
+    Terrain t(mp_context.get(), NO_CAVES, 0);
+    t.CreateTestScene();
+    Chunk *c = t.getChunkAt(176, 0);
+    QCOMPARE(c->state(), UPLOADED);
+    QVERIFY(t.getChunkAt(192, 0) == nullptr);
+
+    // Stands so that the zone east of c is wanted. Stops as soon as c's
+    // neighbour there is generated, before the terrain has seen it.
+    const glm::vec3 pos(112.f, 140.f, 48.f);
+    t.tryExpansion(pos);
+    Chunk *n = nullptr;
+    for (int i = 0; i < 1000 && (n == nullptr || !n->blocksFilled()); ++i) {
+        t.multiThreadedWork(pos, glm::vec3(1.f, 0.f, 0.f), 0.f);
+        t.waitForJobs();
+        n = t.getChunkAt(192, 0);
+    }
+    QVERIFY(n != nullptr && n->blocksFilled());
+
+    QCOMPARE(t.getBlockAt(184, 250, 8), EMPTY);
+    t.setBlockAt(184, 250, 8, STONE);
+    t.remeshDirtyChunks();
+    t.waitForJobs();
+    // Sees n generated, then runs the upload task of the remesh of c
+    t.checkThreadResults(pos);
+    settle(t, pos);
+
+    QCOMPARE(c->state(), UPLOADED);
+    uPtr<ChunkVBOData> current;
+    MeshBufferPool buffers;
+    VBOWorker(c, current, buffers, PER_FACE).run();
+    QVERIFY(current != nullptr);
+    QCOMPARE(c->lastMeshVertices(false), unsigned(current->m_vboDataOpaque.size()));
+}
+
+// A remesh that finishes after its zone left the view must not give the
+// chunk buffers again, nor keep the edit off the GPU once the zone is back
+void TestTerrain::remeshDroppedAfterEviction() {
+    Terrain t(mp_context.get(), NO_CAVES, 0);
+    t.CreateTestScene();
+    Chunk *c = t.getChunkAt(8, 8);
+    unsigned before = c->lastMeshVertices(false);
+
+    t.setBlockAt(8, 250, 8, STONE);
+    t.remeshDirtyChunks();
+    t.waitForJobs();
+    // Far enough that the zone of c is evicted
+    t.tryExpansion(PLAYER_POS + glm::vec3(320.f, 0.f, 0.f));
+    QCOMPARE(c->state(), EVICTED);
+    // Runs the upload task of the remesh
+    t.checkThreadResults(PLAYER_POS + glm::vec3(320.f, 0.f, 0.f));
+    QVERIFY(!c->mcr_VBOcreated);
+
+    t.tryExpansion(PLAYER_POS);
+    settle(t, PLAYER_POS);
+    QCOMPARE(c->state(), UPLOADED);
+    QCOMPARE(c->lastMeshVertices(false), before + 24);
+}
+
+QTEST_MAIN(TestTerrain)
+#include "tst_terrain.moc"
@@ -0,0 +1,109 @@
+#include <QtTest>
+#include "worldcheck.h"
+#include "scene/heightmap.h"
+#include "scene/noisekernels.h"
+#include <array>
+
+// Chunks along each side of the recorded worlds
+constexpr int CHECK_SIZE = 4;
+
+// A world as generated when its checksums were recorded
+struct RecordedWorld {
+    uint64_t seed;
+    CaveMode caves;
+    std::array<uint64_t, CHECK_SIZE * CHECK_SIZE> checksums;
+};
+
+// Indexed by CaveMode, to print recorded worlds as they are written below
+const char *const CAVE_MODE_NAMES[] = {"NO_CAVES", "EXACT_CAVES", "FAST_CAVES"};
+
+// Only replace these, with what this test prints for a world that no
+// longer matches, in changes that mean to alter the generated blocks
+const RecordedWorld RECORDED_WORLDS[] = {
+    {0, NO_CAVES, {{
+        0xb8c0881519803a45ull, 0x1c64821775ded9e6ull, 0x321355763a323401ull, 0xba5fb8dc9111a88dull,
+        0x5b735fa0f16820b9ull, 0xb92c31c40fd6a67dull, 0x502575983a0184a1ull, 0xe57dd2308b87fc1ull,
+        0xf83087277107d9a3ull, 0x7ff0b51c85de89a1ull, 0x39279eec96c24c79ull, 0x17e43a8527ce9729ull,
+        0x3dd37a21b1bb441ull, 0xca4d5a5ff7466191ull, 0x5abff19368d54089ull, 0x5dcc5e008e730b0bull,
+    }}},
+    {0, FAST_CAVES, {{
+        0xf0f07e89cbed2cfdull, 0x9334d77249d4047bull, 0xea5f24fede3b9aaeull, 0xe8b83fd77fca702ull,
+        0xd75d21144bf7b10eull, 0x6f33b0599d49fc11ull, 0xaee5a89574b13268ull, 0xb80682041dc08465ull,
+        0xe769269b60fa8be7ull, 0x566ed6efad3a5250ull, 0x5235296f2f783311ull, 0x1096872196d67e87ull,
+        0xbe152f4db069ef5cull, 0x5053b2333268021full, 0x1e88d38ae19f41ecull, 0x7f5dde7e0405785bull,
+    }}},
+    {0, EXACT_CAVES, {{
+        0x916e41831c993be3ull, 0xc373573db25f51a7ull, 0x894c73e38beb4ea2ull, 0x3fbcaa8caf960c0full,
+        0xde8f28d8b5a8676dull, 0x163424e953b0389bull, 0x3d0b025aefa6ebfaull, 0x61d9ac028442e36dull,
+        0xedc64ea441985d62ull, 0x4287a1b9179bd6f1ull, 0xa70e32aa021bf359ull, 0xe16cc7fa27bbedbull,
+        0xc37bc4fef8c62057ull, 0xe9b0fdc7a0b754baull, 0xe1877a34321f10baull, 0x60d7db84f30439d7ull,
+    }}},
+    {277, FAST_CAVES, {{
+        0x4981064387ef1485ull, 0x723f7af8637a6190ull, 0xd0df5d6a8ed99995ull, 0x7782813c64cb0718ull,
+        0x4ec12dee2609bf5bull, 0x1544007d4efffff8ull, 0x289b9b131cfa3c65ull, 0x8ea66cdbfffe070bull,
+        0x85731cdfbe60768dull, 0x91e842b61db28149ull, 0x959d8beed9293d4cull, 0x4c514aba650bf8d0ull,
+        0xc8a5bf0ceda781e5ull, 0xc22d4ee4c2ce13d0ull, 0xee68eea7f8efb4d0ull, 0x6aab21235e019a06ull,
+    }}},
+};
+
+class TestWorldGen : public QObject {
+    Q_OBJECT
+
+private:
+    NoiseIsa m_isa;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void recordedWorlds_data();
+    // Generates each recorded world with each noise kernel and compares
+    // its chunk checksums to the recorded ones
+    void recordedWorlds();
+};
+
+void TestWorldGen::initTestCase() {
+    m_isa = noiseIsa();
+}
+
+void TestWorldGen::cleanupTestCase() {
+    setNoiseIsa(m_isa);
+}
+
+void TestWorldGen::recordedWorlds_data() {
+    QTest::addColumn<int>("isa");
+    QTest::addColumn<int>("world");
+    for (int isa = NOISE_SCALAR; isa <= NOISE_AVX; ++isa) {
+        for (int w = 0; w < int(std::size(RECORDED_WORLDS)); ++w) {
+            QTest::addRow("%s, seed %llu, %s", noiseIsaName(NoiseIsa(isa)),
+                          static_cast<unsigned long long>(RECORDED_WORLDS[w].seed),
+                          CAVE_MODE_NAMES[RECORDED_WORLDS[w].caves]) << isa << w;
+        }
+    }
+}
+
+void TestWorldGen::recordedWorlds() {
+    QFETCH(int, isa);
+    QFETCH(int, world);
+    if (!setNoiseIsa(NoiseIsa(isa))) {
+        QSKIP("Not supported by this CPU");
+    }
+    const RecordedWorld &w = RECORDED_WORLDS[world];
+    std::vector<uint64_t> checksums = worldChecksums(w.seed, w.caves, CHECK_SIZE);
+    std::vector<uint64_t> recorded(w.checksums.begin(), w.checksums.end());
+    if (checksums != recorded) {
+        // The world as it would be written above
+        QString entry = QString("    {%1, %2, {{").arg(w.seed).arg(CAVE_MODE_NAMES[w.caves]);
+        for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; ++i) {
+            entry += (i % 4 == 0 ? "\n        " : " ");
+            entry += QString("0x%1ull,").arg(checksums[i], 0, 16);
+        }
+        entry += "\n    }}},";
+        qInfo("%s", qPrintable(entry));
+    }
+    for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; ++i) {
+        QCOMPARE(checksums[i], recorded[i]);
+    }
+}
+
+QTEST_MAIN(TestWorldGen)
+#include "tst_worldgen.moc"
@@ -0,0 +1,5 @@
+include(../../tests.pri)
+
+TARGET = tst_worldgen
+
+SOURCES += tst_worldgen.cpp
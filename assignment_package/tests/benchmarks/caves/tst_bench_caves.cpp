@@ -0,0 +1,70 @@
+#include <QtTest>
+#include "blocktypeworker.h"
+#include "scene/heightmap.h"
+#include <array>
+
+// Chunks along each side of the square generated by each pass, away from
+// the origin so that every biome shows up
+constexpr int SIDE = 8;
+constexpr int ORIGIN = -320;
+constexpr double CHUNKS = SIDE * SIDE;
+
+class BenchCaves : public QObject {
+    Q_OBJECT
+
+private:
+    HeightMap m_heightMap{0};
+    // Seconds per chunk with each CaveMode, once its row has run
+    std::array<double, 3> m_secondsPerChunk{};
+
+private slots:
+    void generate_data();
+    // BlockTypeWorker::run of every chunk, with each cave mode
+    void generate();
+    // How much longer each cave mode takes than NO_CAVES
+    void cleanupTestCase();
+};
+
+void BenchCaves::generate_data() {
+    QTest::addColumn<int>("caves");
+    QTest::newRow("NO_CAVES") << int(NO_CAVES);
+    QTest::newRow("EXACT_CAVES") << int(EXACT_CAVES);
+    QTest::newRow("FAST_CAVES") << int(FAST_CAVES);
+}
+
+void BenchCaves::generate() {
+    QFETCH(int, caves);
+    std::unordered_set<int64_t> generatedZones;
+    std::unordered_map<int64_t, int> zoneChunksLeft;
+    QMutex zonesMux;
+    MPSCQueue<Chunk*> generated(SIDE * SIDE);
+    int passes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        for (int cz = 0; cz < SIDE; ++cz) {
+            for (int cx = 0; cx < SIDE; ++cx) {
+                Chunk chunk(nullptr, glm::ivec2(ORIGIN + 16 * cx, ORIGIN + 16 * cz));
+                BlockTypeWorker(&chunk, generatedZones, zoneChunksLeft, &zonesMux,
+                                generated, m_heightMap, CaveMode(caves)).run();
+            }
+        }
+        Chunk *c;
+        while (generated.tryPop(c)) {}
+        passes++;
+    }
+    m_secondsPerChunk[caves] = timer.nsecsElapsed() * 1e-9 / (passes * CHUNKS);
+    qInfo("%.0f chunks/s", 1.0 / m_secondsPerChunk[caves]);
+}
+
+void BenchCaves::cleanupTestCase() {
+    double none = m_secondsPerChunk[NO_CAVES];
+    if (none == 0.0) {
+        return;
+    }
+    qInfo("EXACT_CAVES takes %.2fx as long as NO_CAVES", m_secondsPerChunk[EXACT_CAVES] / none);
+    qInfo("FAST_CAVES takes %.2fx as long as NO_CAVES", m_secondsPerChunk[FAST_CAVES] / none);
+}
+
+QTEST_MAIN(BenchCaves)
+#include "tst_bench_caves.moc"
@@ -0,0 +1,86 @@
+#include <QtTest>
+#include "scene/heightmap.h"
+#include "scene/noisekernels.h"
+
+// Chunks along each side of the square swept by each benchmark, away from
+// the origin so that every biome shows up
+constexpr int SIDE = 32;
+constexpr int ORIGIN = -300;
+constexpr double COLUMNS = SIDE * SIDE * 256.0;
+
+class BenchHeightTile : public QObject {
+    Q_OBJECT
+
+private:
+    HeightMap m_heightMap{0};
+    NoiseIsa m_isa;
+
+    void printRate(const QElapsedTimer &timer, int passes) const;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    // HeightMap::getHeight of every column on its own, as generation did
+    // before tiles
+    void perColumn();
+    void tile_data();
+    // HeightMap::getHeightTile of every chunk, with each noise kernel
+    void tile();
+};
+
+void BenchHeightTile::printRate(const QElapsedTimer &timer, int passes) const {
+    qInfo("%.0f columns/s", passes * COLUMNS / (timer.nsecsElapsed() * 1e-9));
+}
+
+void BenchHeightTile::initTestCase() {
+    m_isa = noiseIsa();
+}
+
+void BenchHeightTile::cleanupTestCase() {
+    setNoiseIsa(m_isa);
+}
+
+void BenchHeightTile::perColumn() {
+    int passes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        for (int z = ORIGIN; z < ORIGIN + 16 * SIDE; ++z) {
+            for (int x = ORIGIN; x < ORIGIN + 16 * SIDE; ++x) {
+                m_heightMap.getHeight(x, z);
+            }
+        }
+        passes++;
+    }
+    printRate(timer, passes);
+}
+
+void BenchHeightTile::tile_data() {
+    QTest::addColumn<int>("isa");
+    for (int isa = NOISE_SCALAR; isa <= NOISE_AVX; ++isa) {
+        QTest::newRow(noiseIsaName(NoiseIsa(isa))) << isa;
+    }
+}
+
+void BenchHeightTile::tile() {
+    QFETCH(int, isa);
+    if (!setNoiseIsa(NoiseIsa(isa))) {
+        QSKIP("Not supported by this CPU");
+    }
+    HeightTile tile;
+    int passes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        for (int cz = 0; cz < SIDE; ++cz) {
+            for (int cx = 0; cx < SIDE; ++cx) {
+                m_heightMap.getHeightTile(ORIGIN + 16 * cx, ORIGIN + 16 * cz, tile);
+            }
+        }
+        passes++;
+    }
+    printRate(timer, passes);
+}
+
+QTEST_MAIN(BenchHeightTile)
+#include "tst_bench_heighttile.moc"
@@ -0,0 +1,9 @@
+include(../../tests.pri)
+
+# Timings only, so `make check` leaves it out
+CONFIG -= testcase
+CONFIG += benchmark
+
+TARGET = tst_bench_mesher
+
+SOURCES += tst_bench_mesher.cpp
@@ -0,0 +1,196 @@
+#include <QtTest>
+#include "blocktypeworker.h"
+#include "vboworker.h"
+#include "scene/heightmap.h"
+
+// Chunks along each side of the square generated for the benchmarks, away
+// from the origin so that every biome shows up. Only the chunks inside its
+// border are meshed, so that each of them has all four neighbors.
+constexpr int SIDE = 10;
+constexpr int ORIGIN = -320;
+constexpr double MESHED = (SIDE - 2) * (SIDE - 2);
+
+class BenchMesher : public QObject {
+    Q_OBJECT
+
+private:
+    std::vector<uPtr<Chunk>> m_chunks;
+    MeshBufferPool m_buffers;
+    // Quads the reference mesher makes for all of the meshed chunks
+    size_t m_referenceQuads = 0;
+
+    Chunk *chunkAt(int cx, int cz) const;
+    // Meshes each chunk inside the border, and returns how many quads
+    // mesh made for all of them
+    template<typename Mesh>
+    size_t meshAll(Mesh mesh) const;
+    // Chunk::faceVisible against each of the six neighbors of every block,
+    // then Chunk::createVBOdataCube, as chunks were meshed before
+    // VBOWorker::meshPerFace
+    size_t meshReference(Chunk *c, std::vector<ChunkVertex> &opaque,
+                         std::vector<ChunkVertex> &transparent) const;
+    // A VBOWorker in mode
+    size_t meshWorker(Chunk *c, MeshMode mode);
+
+    void printRate(const QElapsedTimer &timer, int passes, size_t quads) const;
+
+private slots:
+    void initTestCase();
+    void reference();
+    void perFace();
+    void greedy();
+};
+
+Chunk *BenchMesher::chunkAt(int cx, int cz) const {
+    return m_chunks[cx + SIDE * cz].get();
+}
+
+template<typename Mesh>
+size_t BenchMesher::meshAll(Mesh mesh) const {
+    size_t quads = 0;
+    for (int cz = 1; cz < SIDE - 1; ++cz) {
+        for (int cx = 1; cx < SIDE - 1; ++cx) {
+            quads += mesh(chunkAt(cx, cz));
+        }
+    }
+    return quads;
+}
+
+size_t BenchMesher::meshReference(Chunk *c, std::vector<ChunkVertex> &opaque,
+                                  std::vector<ChunkVertex> &transparent) const {
+    // Blocks outside the chunk come from its neighbors; above and below
+    // the world there are none
+    auto blockAt = [c](int x, int y, int z) {
+        if (y < 0 || y > 255) {
+            return EMPTY;
+        }
+        const Chunk *owner = c;
+        if (x < 0) {
+            owner = c->mcr_neighbors.at(XNEG);
+            x += 16;
+        } else if (x > 15) {
+            owner = c->mcr_neighbors.at(XPOS);
+            x -= 16;
+        } else if (z < 0) {
+            owner = c->mcr_neighbors.at(ZNEG);
+            z += 16;
+        } else if (z > 15) {
+            owner = c->mcr_neighbors.at(ZPOS);
+            z -= 16;
+        }
+        return owner->getBlockAt(x, y, z);
+    };
+    const glm::ivec3 steps[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+    opaque.clear();
+    transparent.clear();
+    for (int y = 0; y < 256; ++y) {
+        for (int z = 0; z < 16; ++z) {
+            for (int x = 0; x < 16; ++x) {
+                BlockType t = c->getBlockAt(x, y, z);
+                if (t == EMPTY) {
+                    continue;
+                }
+                unsigned int faces = 0;
+                for (int d = 0; d < 6; ++d) {
+                    glm::ivec3 n = glm::ivec3(x, y, z) + steps[d];
+                    if (Chunk::faceVisible(t, blockAt(n.x, n.y, n.z), Direction(d))) {
+                        faces |= 1u << d;
+                    }
+                }
+                if (faces != 0) {
+                    c->createVBOdataCube(t, faces, glm::ivec3(x, y, z),
+                                         blockProperties(t).transparent ? transparent : opaque);
+                }
+            }
+        }
+    }
+    return (opaque.size() + transparent.size()) / 4;
+}
+
+size_t BenchMesher::meshWorker(Chunk *c, MeshMode mode) {
+    uPtr<ChunkVBOData> data;
+    VBOWorker(c, data, m_buffers, mode).run();
+    return (data->m_vboDataOpaque.size() + data->m_vboDataTransparent.size()) / 4;
+}
+
+void BenchMesher::printRate(const QElapsedTimer &timer, int passes, size_t quads) const {
+    qInfo("%.0f chunks/s, %zu quads", passes * MESHED / (timer.nsecsElapsed() * 1e-9), quads);
+}
+
+void BenchMesher::initTestCase() {
+    HeightMap heightMap(0);
+    std::unordered_set<int64_t> generatedZones;
+    std::unordered_map<int64_t, int> zoneChunksLeft;
+    QMutex zonesMux;
+    MPSCQueue<Chunk*> generated(SIDE * SIDE);
+    for (int cz = 0; cz < SIDE; ++cz) {
+        for (int cx = 0; cx < SIDE; ++cx) {
+            m_chunks.push_back(mkU<Chunk>(nullptr, glm::ivec2(ORIGIN + 16 * cx, ORIGIN + 16 * cz)));
+            Chunk *c = m_chunks.back().get();
+            BlockTypeWorker(c, generatedZones, zoneChunksLeft, &zonesMux,
+                            generated, heightMap, NO_CAVES).run();
+            if (cx > 0) {
+                c->linkNeighbor(chunkAt(cx - 1, cz), XNEG);
+            }
+            if (cz > 0) {
+                c->linkNeighbor(chunkAt(cx, cz - 1), ZNEG);
+            }
+        }
+    }
+    QVERIFY(chunkAt(SIDE - 1, SIDE - 1)->blocksFilled());
+
+    std::vector<ChunkVertex> opaque, transparent;
+    m_referenceQuads = meshAll([&](Chunk *c) {
+        return meshReference(c, opaque, transparent);
+    });
+}
+
+void BenchMesher::reference() {
+    std::vector<ChunkVertex> opaque, transparent;
+    size_t quads = 0;
+    int passes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        quads = meshAll([&](Chunk *c) {
+            return meshReference(c, opaque, transparent);
+        });
+        passes++;
+    }
+    printRate(timer, passes, quads);
+}
+
+void BenchMesher::perFace() {
+    size_t quads = 0;
+    int passes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        quads = meshAll([&](Chunk *c) {
+            return meshWorker(c, PER_FACE);
+        });
+        passes++;
+    }
+    printRate(timer, passes, quads);
+    // One quad for every visible face, so exactly the reference's
+    QCOMPARE(quads, m_referenceQuads);
+}
+
+void BenchMesher::greedy() {
+    size_t quads = 0;
+    int passes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        quads = meshAll([&](Chunk *c) {
+            return meshWorker(c, GREEDY);
+        });
+        passes++;
+    }
+    printRate(timer, passes, quads);
+    QVERIFY(quads <= m_referenceQuads);
+}
+
+QTEST_MAIN(BenchMesher)
+#include "tst_bench_mesher.moc"
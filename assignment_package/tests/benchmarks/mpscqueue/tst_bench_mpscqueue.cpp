@@ -0,0 +1,82 @@
+#include <QtTest>
+#include <QMutex>
+#include "mpscqueue.h"
+#include <thread>
+#include <vector>
+
+// Like the workers handing finished chunks to the main thread: a few
+// producers each push many small results while one consumer drains them
+constexpr int PRODUCERS = 8;
+constexpr int ITEMS_PER_PRODUCER = 100000;
+
+class BenchMPSCQueue : public QObject {
+    Q_OBJECT
+
+private slots:
+    void mpscQueue();
+    // What the result queues replaced: a vector behind a mutex that the
+    // consumer swaps out each time it drains it
+    void mutexVector();
+};
+
+void BenchMPSCQueue::mpscQueue() {
+    QBENCHMARK {
+        MPSCQueue<uPtr<int>> q(1024);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&q] {
+                for (int i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+                    q.push(mkU<int>(i));
+                }
+            });
+        }
+        int popped = 0;
+        uPtr<int> v;
+        while (popped < PRODUCERS * ITEMS_PER_PRODUCER) {
+            if (q.tryPop(v)) {
+                popped++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        for (std::thread &t : producers) {
+            t.join();
+        }
+    }
+}
+
+void BenchMPSCQueue::mutexVector() {
+    QBENCHMARK {
+        QMutex mux;
+        std::vector<uPtr<int>> shared;
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&mux, &shared] {
+                for (int i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+                    uPtr<int> v = mkU<int>(i);
+                    QMutexLocker locker(&mux);
+                    shared.push_back(std::move(v));
+                }
+            });
+        }
+        int popped = 0;
+        std::vector<uPtr<int>> drained;
+        while (popped < PRODUCERS * ITEMS_PER_PRODUCER) {
+            {
+                QMutexLocker locker(&mux);
+                drained.swap(shared);
+            }
+            if (drained.empty()) {
+                std::this_thread::yield();
+            }
+            popped += int(drained.size());
+            drained.clear();
+        }
+        for (std::thread &t : producers) {
+            t.join();
+        }
+    }
+}
+
+QTEST_MAIN(BenchMPSCQueue)
+#include "tst_bench_mpscqueue.moc"
@@ -0,0 +1,44 @@
+# Shared by every test and benchmark: builds the engine sources they need,
+# without the main window, against QtTest. Run them with `make check`.
+QT += core widgets openglwidgets testlib
+
+CONFIG += console
+CONFIG += c++1z
+CONFIG += testcase
+CONFIG -= app_bundle
+win32 {
+    LIBS += -lopengl32
+    LIBS += -lglu32
+}
+
+ENGINE = $$PWD/../src
+
+INCLUDEPATH += $$PWD/../include $$ENGINE $$ENGINE/scene
+
+SOURCES += \
+    $$ENGINE/blocktypeworker.cpp \
+    $$ENGINE/worldcheck.cpp \
+    $$ENGINE/lsystem.cpp \
+    $$ENGINE/shaderprogram.cpp \
+    $$ENGINE/drawable.cpp \
+    $$ENGINE/openglcontext.cpp \
+    $$ENGINE/scene/terrain.cpp \
+    $$ENGINE/scene/entity.cpp \
+    $$ENGINE/scene/player.cpp \
+    $$ENGINE/scene/camera.cpp \
+    $$ENGINE/scene/chunk.cpp \
+    $$ENGINE/scene/chunksection.cpp \
+    $$ENGINE/scene/chunkmap.cpp \
+    $$ENGINE/scene/chunkgrid.cpp \
+    $$ENGINE/scene/noisekernels.cpp \
+    $$ENGINE/scene/heightmap.cpp \
+    $$ENGINE/vboworker.cpp \
+    $$ENGINE/meshbufferpool.cpp \
+    $$ENGINE/chunkscheduler.cpp \
+    $$ENGINE/jobsystem.cpp
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
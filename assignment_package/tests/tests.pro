@@ -0,0 +1,12 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    auto/chunkmap \
+    auto/jobsystem \
+    auto/mpscqueue \
+    auto/terrain \
+    auto/worldgen \
+    benchmarks/caves \
+    benchmarks/heighttile \
+    benchmarks/mesher \
+    benchmarks/mpscqueue